@@ -0,0 +1,69 @@
+/*
+	Copyright (c) 2010 ASTRE Henri (http://www.visual-experiments.com)
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+	THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <PhotoSynthParser.h>
+
+//Split the cameras of the first coordinate system into size-bounded, overlapping clusters for PMVS (ske.dat).
+//Co-visibility (number of PhotoSynth points seen by both cameras) is taken from the observations stored in
+//the bin files, camera positions are used for the cameras that do not share any point.
+//-> strongest pairs are merged first as long as the cluster stays under maxClusterSize
+//-> clusters smaller than maxClusterSize/4 are merged into the most linked (or closest) cluster with room left
+//-> each cluster borrows its overlap most linked cameras from the other clusters
+class ClusteringComputer
+{
+	public:
+		ClusteringComputer(unsigned int maxClusterSize = 100, unsigned int overlap = 20);
+
+		//read cameras and bin file observations of a synth downloaded by PhotoSynthDownloader
+		bool load(const std::string& inputFolder);
+
+		void computeClusters();
+
+		unsigned int getNbPicture() const;
+		const std::vector<std::vector<int> >& getClusters() const;
+
+		//number of points seen by both pictures
+		unsigned int getCovisibility(unsigned int i, unsigned int j) const;
+
+		static bool saveSke(const std::string& filepath, unsigned int nbPicture, const std::vector<std::vector<int> >& clusters);
+
+	protected:
+		void addObservations(const std::vector<std::vector<PhotoSynth::VertexInfo> >& infos, unsigned int nbVertex);
+		void mergeSmallClusters();
+		void addOverlap();
+
+		inline std::size_t getIndex(unsigned int i, unsigned int j) const //i < j
+		{
+			return (std::size_t) i * mNbPicture - (std::size_t) i * (i + 1) / 2 + (j - i - 1);
+		}
+
+		unsigned int mMaxClusterSize;
+		unsigned int mOverlap;
+		unsigned int mNbPicture;
+		std::vector<Ogre::Vector3> mPositions;
+		std::vector<unsigned int> mCovisibility; //upper triangle (i < j)
+		std::vector<std::vector<int> > mClusters;
+};
@@ -0,0 +1,354 @@
+/*
+	Copyright (c) 2010 ASTRE Henri (http://www.visual-experiments.com)
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+	THE SOFTWARE.
+*/
+
+#include "PMVSClusteringComputer.h"
+
+#include <PhotoSynthBinFileReader.h>
+#include <boost/filesystem/operations.hpp>
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+
+using namespace PhotoSynth;
+namespace bf = boost::filesystem;
+
+namespace
+{
+	struct PicturePair
+	{
+		unsigned int covisibility;
+		unsigned int i;
+		unsigned int j;
+	};
+
+	bool compareCovisibility(const PicturePair& a, const PicturePair& b)
+	{
+		return a.covisibility > b.covisibility;
+	}
+
+	unsigned int findRoot(std::vector<unsigned int>& parents, unsigned int i)
+	{
+		while (parents[i] != i)
+		{
+			parents[i] = parents[parents[i]];
+			i = parents[i];
+		}
+
+		return i;
+	}
+}
+
+ClusteringComputer::ClusteringComputer(unsigned int maxClusterSize, unsigned int overlap)
+{
+	mMaxClusterSize = std::max(maxClusterSize, 1u);
+	mOverlap        = overlap;
+	mNbPicture      = 0;
+}
+
+bool ClusteringComputer::load(const std::string& inputFolder)
+{
+	std::string jsonFilePath = Parser::createFilePath(inputFolder, Parser::jsonFilename);
+	std::string soapFilePath = Parser::createFilePath(inputFolder, Parser::soapFilename);
+	std::string guidFilePath = Parser::createFilePath(inputFolder, Parser::guidFilename);
+	if (!bf::exists(jsonFilePath) || !bf::exists(soapFilePath) || !bf::exists(guidFilePath))
+	{
+		std::cout << "Error: " << Parser::jsonFilename << ", " << Parser::soapFilename << " or " << Parser::guidFilename << " missing: you need to run PhotoSynthDownloader first !" << std::endl;
+		return false;
+	}
+
+	Parser parser;
+	parser.parseSoap(soapFilePath);
+	parser.parseJson(jsonFilePath, Parser::getGuid(guidFilePath));
+	if (parser.getNbCoordSystem() == 0)
+	{
+		std::cout << "Error: no coord system in this synth" << std::endl;
+		return false;
+	}
+
+	//PMVS picture i is camera i of the first coord system (see PhotoSynth2PMVS)
+	const CoordSystem& coordSystem = parser.getCoordSystem(0);
+	mNbPicture = (unsigned int) coordSystem.cameras.size();
+	mPositions.resize(mNbPicture);
+	for (unsigned int i=0; i<mNbPicture; ++i)
+		mPositions[i] = coordSystem.cameras[i].position;
+
+	mCovisibility.clear();
+	mCovisibility.resize(mNbPicture > 1 ? (std::size_t) mNbPicture * (mNbPicture - 1) / 2 : 0, 0);
+
+	for (unsigned int i=0; i<coordSystem.nbBinFile; ++i)
+	{
+		std::vector<std::vector<VertexInfo> > infos;
+		BinFileReader reader;
+		if (!reader.open(BinFileReader::getFilePath(inputFolder, 0, i), &infos))
+		{
+			std::cout << "Error: failed to read " << BinFileReader::getFilePath(inputFolder, 0, i) << std::endl;
+			return false;
+		}
+		addObservations(infos, reader.getNbVertex());
+	}
+	mClusters.clear();
+
+	return true;
+}
+
+void ClusteringComputer::addObservations(const std::vector<std::vector<VertexInfo> >& infos, unsigned int nbVertex)
+{
+	//infos[k] belongs to camera k of coord system 0, which is also PMVS picture k: the picture index here
+	//is the camera position, Camera::index (the synth picture index) is only needed to find the image file
+	//invert the per picture observations: pictures seeing each vertex (in increasing picture order)
+	unsigned int nbInfoPicture = std::min((unsigned int) infos.size(), mNbPicture);
+	std::vector<unsigned int> offsets(nbVertex + 1, 0);
+	for (unsigned int i=0; i<nbInfoPicture; ++i)
+	{
+		for (unsigned int j=0; j<infos[i].size(); ++j)
+		{
+			if (infos[i][j].vertexIndex < nbVertex)
+				offsets[infos[i][j].vertexIndex + 1]++;
+		}
+	}
+	for (unsigned int i=0; i<nbVertex; ++i)
+		offsets[i+1] += offsets[i];
+
+	std::vector<unsigned int> pictures(offsets[nbVertex]);
+	std::vector<unsigned int> cursors(offsets.begin(), offsets.end() - 1);
+	for (unsigned int i=0; i<nbInfoPicture; ++i)
+	{
+		for (unsigned int j=0; j<infos[i].size(); ++j)
+		{
+			if (infos[i][j].vertexIndex < nbVertex)
+				pictures[cursors[infos[i][j].vertexIndex]++] = i;
+		}
+	}
+
+	for (unsigned int v=0; v<nbVertex; ++v)
+	{
+		for (unsigned int a=offsets[v]; a<offsets[v+1]; ++a)
+		{
+			for (unsigned int b=a+1; b<offsets[v+1]; ++b)
+			{
+				if (pictures[a] != pictures[b])
+					mCovisibility[getIndex(pictures[a], pictures[b])]++;
+			}
+		}
+	}
+}
+
+unsigned int ClusteringComputer::getNbPicture() const
+{
+	return mNbPicture;
+}
+
+const std::vector<std::vector<int> >& ClusteringComputer::getClusters() const
+{
+	return mClusters;
+}
+
+unsigned int ClusteringComputer::getCovisibility(unsigned int i, unsigned int j) const
+{
+	if (i == j)
+		return 0;
+	return i < j ? mCovisibility[getIndex(i, j)] : mCovisibility[getIndex(j, i)];
+}
+
+void ClusteringComputer::computeClusters()
+{
+	//strongest pairs first, union of their clusters while the result fits in mMaxClusterSize
+	std::vector<PicturePair> pairs;
+	for (unsigned int i=0; i<mNbPicture; ++i)
+	{
+		for (unsigned int j=i+1; j<mNbPicture; ++j)
+		{
+			PicturePair pair;
+			pair.covisibility = mCovisibility[getIndex(i, j)];
+			pair.i = i;
+			pair.j = j;
+			if (pair.covisibility > 0)
+				pairs.push_back(pair);
+		}
+	}
+	std::sort(pairs.begin(), pairs.end(), compareCovisibility);
+
+	std::vector<unsigned int> parents(mNbPicture);
+	std::vector<unsigned int> sizes(mNbPicture, 1);
+	for (unsigned int i=0; i<mNbPicture; ++i)
+		parents[i] = i;
+
+	for (unsigned int i=0; i<pairs.size(); ++i)
+	{
+		unsigned int rootA = findRoot(parents, pairs[i].i);
+		unsigned int rootB = findRoot(parents, pairs[i].j);
+		if (rootA != rootB && sizes[rootA] + sizes[rootB] <= mMaxClusterSize)
+		{
+			parents[rootB] = rootA;
+			sizes[rootA] += sizes[rootB];
+		}
+	}
+
+	mClusters.clear();
+	std::vector<int> clusterIndexes(mNbPicture, -1);
+	for (unsigned int i=0; i<mNbPicture; ++i)
+	{
+		unsigned int root = findRoot(parents, i);
+		if (clusterIndexes[root] < 0)
+		{
+			clusterIndexes[root] = (int) mClusters.size();
+			mClusters.push_back(std::vector<int>());
+		}
+		mClusters[clusterIndexes[root]].push_back(i);
+	}
+
+	mergeSmallClusters();
+	addOverlap();
+
+	for (unsigned int i=0; i<mClusters.size(); ++i)
+		std::sort(mClusters[i].begin(), mClusters[i].end());
+}
+
+void ClusteringComputer::mergeSmallClusters()
+{
+	unsigned int minClusterSize = std::max(mMaxClusterSize / 4, 1u);
+	std::vector<bool> isFinal(mClusters.size(), false);
+
+	while (true)
+	{
+		//smallest cluster still to be merged
+		int small = -1;
+		for (unsigned int i=0; i<mClusters.size(); ++i)
+		{
+			if (!isFinal[i] && mClusters[i].size() < minClusterSize && (small < 0 || mClusters[i].size() < mClusters[small].size()))
+				small = (int) i;
+		}
+		if (small < 0)
+			break;
+
+		std::vector<int> labels(mNbPicture);
+		for (unsigned int i=0; i<mClusters.size(); ++i)
+		{
+			for (unsigned int j=0; j<mClusters[i].size(); ++j)
+				labels[mClusters[i][j]] = (int) i;
+		}
+
+		std::vector<unsigned long long> links(mClusters.size(), 0);
+		for (unsigned int i=0; i<mClusters[small].size(); ++i)
+		{
+			for (unsigned int j=0; j<mNbPicture; ++j)
+				links[labels[j]] += getCovisibility(mClusters[small][i], j);
+		}
+
+		Ogre::Vector3 center(Ogre::Vector3::ZERO);
+		for (unsigned int i=0; i<mClusters[small].size(); ++i)
+			center += mPositions[mClusters[small][i]];
+		center /= (Ogre::Real) mClusters[small].size();
+
+		//most linked cluster with room left, or the closest one if no point is shared
+		int target = -1;
+		Ogre::Real targetDistance = std::numeric_limits<Ogre::Real>::max();
+		for (unsigned int i=0; i<mClusters.size(); ++i)
+		{
+			if ((int) i == small || mClusters[i].size() + mClusters[small].size() > mMaxClusterSize)
+				continue;
+
+			Ogre::Real distance = std::numeric_limits<Ogre::Real>::max();
+			for (unsigned int j=0; j<mClusters[i].size(); ++j)
+				distance = std::min(distance, center.squaredDistance(mPositions[mClusters[i][j]]));
+
+			if (target < 0 || links[i] > links[target] || (links[i] == links[target] && distance < targetDistance))
+			{
+				target = (int) i;
+				targetDistance = distance;
+			}
+		}
+
+		if (target < 0)
+		{
+			isFinal[small] = true;
+			continue;
+		}
+
+		mClusters[target].insert(mClusters[target].end(), mClusters[small].begin(), mClusters[small].end());
+		mClusters.erase(mClusters.begin() + small);
+		isFinal.erase(isFinal.begin() + small);
+	}
+}
+
+void ClusteringComputer::addOverlap()
+{
+	if (mOverlap == 0 || mClusters.size() < 2)
+		return;
+
+	std::vector<int> labels(mNbPicture);
+	for (unsigned int i=0; i<mClusters.size(); ++i)
+	{
+		for (unsigned int j=0; j<mClusters[i].size(); ++j)
+			labels[mClusters[i][j]] = (int) i;
+	}
+
+	//borrowed pictures are chosen from the disjoint clusters, then added
+	std::vector<std::vector<int> > overlaps(mClusters.size());
+	for (unsigned int i=0; i<mClusters.size(); ++i)
+	{
+		std::vector<std::pair<unsigned long long, int> > links;
+		for (unsigned int j=0; j<mNbPicture; ++j)
+		{
+			if (labels[j] == (int) i)
+				continue;
+
+			unsigned long long link = 0;
+			for (unsigned int k=0; k<mClusters[i].size(); ++k)
+				link += getCovisibility(mClusters[i][k], j);
+			if (link > 0)
+				links.push_back(std::make_pair(link, (int) j));
+		}
+
+		unsigned int nbBorrowed = std::min(mOverlap, (unsigned int) links.size());
+		std::partial_sort(links.begin(), links.begin() + nbBorrowed, links.end(), std::greater<std::pair<unsigned long long, int> >());
+		for (unsigned int j=0; j<nbBorrowed; ++j)
+			overlaps[i].push_back(links[j].second);
+	}
+
+	for (unsigned int i=0; i<mClusters.size(); ++i)
+		mClusters[i].insert(mClusters[i].end(), overlaps[i].begin(), overlaps[i].end());
+}
+
+bool ClusteringComputer::saveSke(const std::string& filepath, unsigned int nbPicture, const std::vector<std::vector<int> >& clusters)
+{
+	std::ofstream output(filepath.c_str());
+	if (!output.is_open())
+		return false;
+
+	output << "SKE" << std::endl;
+	output << nbPicture << " " << clusters.size() <<std::endl;
+	for (unsigned int i=0; i<clusters.size(); ++i)
+	{
+		output << clusters[i].size() << " 0" << std::endl;
+		for (unsigned int j=0; j<clusters[i].size(); ++j)
+		{
+			output << clusters[i][j] << " ";
+		}
+		output << std::endl;
+	}
+	output.close();
+
+	return true;
+}
@@ -1,7 +1,11 @@
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <sstream>
 #include <vector>
+#include <PhotoSynthPlyReader.h>
+
+#include "PMVSClusteringComputer.h"
 
 union VertexIndex
 {		
@@ -20,30 +24,67 @@ std::vector<int> getPictureIndexes(const std::string& plyFilePath);
 
 int main(int argc, char* argv[])
 {
-	std::ofstream output("ske.dat");
-	if (output.is_open())
+	if (argc < 2)
 	{
-		unsigned int nbImage = 216;
-		unsigned int nbCluster = 3;
+		std::cout << "Usage: " << argv[0] << " <inputFolder> [size=<n>] [overlap=<n>] [manual=<nbCluster>]" << std::endl;
+		std::cout << "<inputFolder>: folder containing the synth, ske.dat is written in <inputFolder>/pmvs" << std::endl;
+		std::cout << "size=<n>: max number of pictures per cluster before overlap (default 100)" << std::endl;
+		std::cout << "overlap=<n>: number of pictures borrowed from other clusters (default 20)" << std::endl;
+		std::cout << "manual=<nbCluster>: use <inputFolder>/bin/cluster_<i>.ply made from cameras_clustering.ply" << std::endl;
+
+		return -1;
+	}
 
-		output << "SKE" << std::endl;
-		output << nbImage << " " << nbCluster <<std::endl;
-		for (unsigned int i=0; i<nbCluster; ++i)
+	std::string inputFolder = argv[1];
+	unsigned int maxClusterSize = 100;
+	unsigned int overlap        = 20;
+	int nbManualCluster         = -1;
+	for (int i=2; i<argc; ++i)
+	{
+		std::string argument(argv[i]);
+		if (argument.find("size=") == 0)
+			maxClusterSize = (unsigned int) std::max(atoi(argument.substr(5).c_str()), 1);
+		else if (argument.find("overlap=") == 0)
+			overlap = (unsigned int) std::max(atoi(argument.substr(8).c_str()), 0);
+		else if (argument.find("manual=") == 0)
+			nbManualCluster = std::max(atoi(argument.substr(7).c_str()), 0);
+		else
+			std::cout << "Unknown argument: " << argument << std::endl;
+	}
+
+	ClusteringComputer computer(maxClusterSize, overlap);
+	if (!computer.load(inputFolder))
+		return -1;
+
+	std::vector<std::vector<int> > clusters;
+	if (nbManualCluster >= 0)
+	{
+		for (int i=0; i<nbManualCluster; ++i)
 		{
 			std::stringstream filename;
-			filename << "cluster_" << i << ".ply";
-			
-			const std::vector<int>& indexes = getPictureIndexes(filename.str());
-			
-			output << indexes.size() << " 0" << std::endl;
-			for (unsigned int j=0; j<indexes.size(); ++j)
-			{
-				output << indexes[j] << " ";
-			}
-			output << std::endl;
+			filename << inputFolder << "/bin/cluster_" << i << ".ply";
+			clusters.push_back(getPictureIndexes(filename.str()));
 		}
 	}
-	output.close();
+	else
+	{
+		computer.computeClusters();
+		clusters = computer.getClusters();
+	}
+
+	std::string skeFilePath = inputFolder + "/pmvs/ske.dat";
+	if (!ClusteringComputer::saveSke(skeFilePath, computer.getNbPicture(), clusters))
+	{
+		std::cout << "Failed to open " << skeFilePath << " for writing" << std::endl;
+		return -1;
+	}
+
+	std::cout << computer.getNbPicture() << " pictures in " << clusters.size() << " clusters:";
+	for (unsigned int i=0; i<clusters.size(); ++i)
+		std::cout << " " << clusters[i].size();
+	std::cout << std::endl;
+
+	return 0;
 }
 
 VertexIndex::VertexIndex(__int32 index)
@@ -61,92 +102,37 @@ std::vector<int> getPictureIndexes(const std::string& plyFilePath)
 {
 	std::vector<int> indexes;
 
-	std::ifstream input;
-	input.open(plyFilePath.c_str(), std::ios::binary);
-
-	if (input.is_open())
+	PhotoSynth::PlyReader reader;
+	if (reader.open(plyFilePath))
 	{
-		std::string line;
-		unsigned int nbVertices = 0;
-		unsigned int nbTriangles = 0;
-		bool isBinaryFile = false;
-		bool hasNormals = false;
-		bool hasColors  = false;
-		bool hasAlpha   = false;
-
-		//parse header
-		do 
-		{
-			std::getline(input, line);
-
-			if (line == "format binary_little_endian 1.0")
-				isBinaryFile = true;
-			else if (line == "format ascii 1.0")
-				isBinaryFile = false;
-			else if (line == "property float nx")
-				hasNormals = true;
-			else if (line == "property uchar red")
-				hasColors = true;
-			else if (line == "property uchar alpha")
-				hasAlpha = true;
-			else if (line == "property uchar diffuse_red")
-				hasColors = true;
-			else if (line == "property uchar diffuse_alpha")
-				hasAlpha = true;
-			else
-			{
-				std::string keywordVertex("element vertex ");
-				unsigned int lengthVertex = keywordVertex.size();
-
-				std::string keywordFace("element face ");
-				unsigned int lengthFace = keywordFace.size();
-
-				if (line.size() > lengthVertex && line.substr(0, lengthVertex) == keywordVertex)
-				{
-					nbVertices = atoi(line.substr(lengthVertex).c_str());
-				}
-				else if (line.size() > lengthFace && line.substr(0, lengthFace) == keywordFace)
-				{
-					nbTriangles = atoi(line.substr(lengthFace).c_str());
-				}
-			}
-		} while (line != "end_header"); //missing eof check...
-
-		if (!isBinaryFile || !hasNormals)
+		const PhotoSynth::PlyReader::Element* element = reader.getElement("vertex");
+		if (reader.getFormat() == PhotoSynth::PlyReader::ASCII || !element || !element->getProperty("nx"))
 		{
 			std::cout << "The file was written in ascii format so indexes store in normals are corrupted !" << std::endl;
 			std::cout << "You need to clean the mesh again and save it in binary format with normals" << std::endl;
 		}
-		else
-		{		
-			float* pos = new float[6];
-			size_t sizePos = sizeof(float)*6;
-
-			unsigned char* color = new unsigned char[hasAlpha?4:3];
-			size_t sizeColor = sizeof(unsigned char)*(hasAlpha?4:3);
-
-			for (unsigned int i=0; i<nbVertices; ++i)
+		else if (element->count > 0)
+		{
+			// nx = index.indexA
+			// ny = index.indexB
+			// nz = 42
+			std::vector<float> normals(3*element->count);
+			std::vector<PhotoSynth::PlyReader::Field> fields;
+			fields.push_back(PhotoSynth::PlyReader::Field("nx", &normals[0], 3*sizeof(float)));
+			fields.push_back(PhotoSynth::PlyReader::Field("ny", &normals[1], 3*sizeof(float)));
+			fields.push_back(PhotoSynth::PlyReader::Field("nz", &normals[2], 3*sizeof(float)));
+
+			if (reader.read("vertex", fields))
 			{
-				input.read((char*)pos, sizePos);
-				if (hasColors)
-					input.read((char*)color, sizeColor);
-
-				// pos[0] = x
-				// pos[1] = y
-				// pos[2] = z
-				// pos[3] = index.indexA
-				// pos[4] = index.indexB
-				// pos[5] = 42
-
-				VertexIndex vindex((unsigned int)pos[3], (unsigned int)pos[4]);
-				if ((unsigned int)pos[5] == 42)
-					indexes.push_back(vindex.index);
+				for (unsigned int i=0; i<element->count; ++i)
+				{
+					VertexIndex vindex((unsigned int)normals[3*i], (unsigned int)normals[3*i+1]);
+					if ((unsigned int)normals[3*i+2] == 42)
+						indexes.push_back(vindex.index);
+				}
 			}
-			delete[] pos;
-			delete[] color;
 		}
 	}
-	input.close();
 
 	return indexes;
 }
\ No newline at end of file
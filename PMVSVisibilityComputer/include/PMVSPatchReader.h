@@ -0,0 +1,104 @@
+/*
+	Copyright (c) 2010 ASTRE Henri (http://www.visual-experiments.com)
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+	THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <boost/cstdint.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+//Streaming reader of PMVS .patch files: only the list of images in which each patch is visible is parsed,
+//position, normal and debug lines are skipped without being converted nor copied.
+//The file is memory-mapped by windows so that multi-GB outputs can be read in a 32 bits process.
+//PATCHS
+//x y z w            (skipped)
+//nx ny nz 0         (skipped)
+//score debug debug  (skipped)
+//nbVisible
+//visible indexes
+//nbDisagree         (skipped)
+//disagree indexes   (skipped)
+class PatchReader
+{
+	public:
+		PatchReader(std::size_t windowSize = defaultWindowSize);
+		~PatchReader();
+
+		bool open(const std::string& filepath);
+		void close();
+
+		unsigned int getNbPatch() const; //count written in the header
+
+		//read the next patch: pictureIndexes is cleared and filled (its capacity is reused between calls)
+		bool readPatch(std::vector<int>& pictureIndexes);
+
+		static const std::size_t defaultWindowSize = 64*1024*1024;
+		static const std::size_t maxPatchSize      = 1024*1024; //a patch never crosses a window boundary
+
+	protected:
+		bool map(boost::uintmax_t offset);
+		bool refill();
+
+		inline void skipSpaces()
+		{
+			while (mData < mEnd && (*mData == ' ' || *mData == '\t' || *mData == '\r' || *mData == '\n'))
+				mData++;
+		}
+
+		inline void skipLine()
+		{
+			while (mData < mEnd && *mData != '\n')
+				mData++;
+			if (mData < mEnd)
+				mData++;
+		}
+
+		inline bool parseInt(int& value)
+		{
+			skipSpaces();
+			bool negative = (mData < mEnd && *mData == '-');
+			if (negative)
+				mData++;
+			if (mData == mEnd || *mData < '0' || *mData > '9')
+				return false;
+
+			value = 0;
+			while (mData < mEnd && *mData >= '0' && *mData <= '9')
+				value = value * 10 + (*mData++ - '0');
+			if (negative)
+				value = -value;
+
+			return true;
+		}
+
+		boost::interprocess::file_mapping*  mFile;
+		boost::interprocess::mapped_region* mRegion;
+		boost::uintmax_t mFileSize;
+		boost::uintmax_t mWindowOffset; //file offset of mBegin
+		std::size_t mWindowSize;
+		const char* mBegin;
+		const char* mEnd;
+		const char* mData;              //current position
+		unsigned int mNbPatch;
+};
@@ -0,0 +1,78 @@
+/*
+	Copyright (c) 2010 ASTRE Henri (http://www.visual-experiments.com)
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+	THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <vector>
+
+//Co-visibility counts between pictures: number of patches seen by both picture i and picture j.
+//Only the upper triangle (i < j) is stored, in a single array: half the memory of a dense matrix and one
+//increment per pair. Each accumulating thread owns its map, maps are merged once all patches are read.
+class VisibilityMap
+{
+	public:
+		VisibilityMap(unsigned int nbPicture = 0);
+
+		unsigned int getNbPicture() const;
+
+		//count every pair of pictures seeing the patch, indexes outside [0, nbPicture) are ignored
+		void addPatch(const int* pictureIndexes, unsigned int nbIndex);
+		void merge(const VisibilityMap& map);
+
+		inline unsigned int get(unsigned int i, unsigned int j) const
+		{
+			if (i == j)
+				return 0;
+			return i < j ? mCounts[getIndex(i, j)] : mCounts[getIndex(j, i)];
+		}
+
+		//pictures sharing more than threshold patches with picture (threshold = -1: every picture)
+		std::vector<int> getNeighbours(unsigned int picture, int threshold) const;
+
+		//the nbNeighbour pictures sharing the most patches with picture (ties: lowest index first)
+		std::vector<int> getTopNeighbours(unsigned int picture, unsigned int nbNeighbour) const;
+
+		//number of pictures sharing more than threshold patches with picture
+		unsigned int getDegree(unsigned int picture, int threshold) const;
+
+		//number of pairs of pictures sharing more than threshold patches (threshold >= 0)
+		std::size_t getNbPair(int threshold) const;
+
+		//smallest threshold >= 0 keeping at most nbNeighbour neighbours per picture on average
+		//(the pairs are ranked by shared patches, ties at the cutoff are all kept or all dropped)
+		int getThreshold(double nbNeighbour) const;
+
+		static std::size_t getMemorySize(unsigned int nbPicture);
+
+	protected:
+		inline std::size_t getIndex(unsigned int i, unsigned int j) const //i < j
+		{
+			return (std::size_t) i * mNbPicture - (std::size_t) i * (i + 1) / 2 + (j - i - 1);
+		}
+
+		const std::vector<unsigned int>& getSortedCounts() const;
+
+		unsigned int mNbPicture;
+		std::vector<unsigned int> mCounts;
+		std::vector<int> mPictures; //sorted indexes of the current patch
+		mutable std::vector<unsigned int> mSortedCounts; //non zero counts, ascending (built on first use)
+};
@@ -0,0 +1,188 @@
+/*
+	Copyright (c) 2010 ASTRE Henri (http://www.visual-experiments.com)
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+	THE SOFTWARE.
+*/
+
+#include "PMVSPatchReader.h"
+
+#include <algorithm>
+#include <cstring>
+#include <boost/filesystem/operations.hpp>
+
+using namespace boost::interprocess;
+
+const std::size_t PatchReader::defaultWindowSize;
+const std::size_t PatchReader::maxPatchSize;
+
+PatchReader::PatchReader(std::size_t windowSize)
+{
+	mFile         = NULL;
+	mRegion       = NULL;
+	mFileSize     = 0;
+	mWindowOffset = 0;
+	mWindowSize   = std::max(windowSize, 2*maxPatchSize);
+	mBegin        = NULL;
+	mEnd          = NULL;
+	mData         = NULL;
+	mNbPatch      = 0;
+}
+
+PatchReader::~PatchReader()
+{
+	close();
+}
+
+bool PatchReader::open(const std::string& filepath)
+{
+	close();
+
+	try
+	{
+		mFileSize = boost::filesystem::file_size(filepath);
+		mFile     = new file_mapping(filepath.c_str(), read_only);
+	}
+	catch (std::exception&)
+	{
+		close();
+		return false;
+	}
+
+	if (!map(0))
+	{
+		close();
+		return false;
+	}
+
+	//PATCHES
+	//nbPatch
+	skipSpaces();
+	int nbPatch = 0;
+	if (mEnd - mData < 7 || memcmp(mData, "PATCHES", 7) != 0)
+	{
+		close();
+		return false;
+	}
+	skipLine();
+	if (!parseInt(nbPatch) || nbPatch < 0)
+	{
+		close();
+		return false;
+	}
+	mNbPatch = (unsigned int) nbPatch;
+
+	return true;
+}
+
+void PatchReader::close()
+{
+	delete mRegion;
+	delete mFile;
+	mRegion       = NULL;
+	mFile         = NULL;
+	mFileSize     = 0;
+	mWindowOffset = 0;
+	mBegin        = NULL;
+	mEnd          = NULL;
+	mData         = NULL;
+	mNbPatch      = 0;
+}
+
+unsigned int PatchReader::getNbPatch() const
+{
+	return mNbPatch;
+}
+
+bool PatchReader::readPatch(std::vector<int>& pictureIndexes)
+{
+	pictureIndexes.clear();
+	if (!mData || !refill())
+		return false;
+
+	skipSpaces();
+	if (mEnd - mData < 6 || memcmp(mData, "PATCHS", 6) != 0)
+		return false;
+
+	skipLine(); //PATCHS
+	skipLine(); //position (4 float)
+	skipLine(); //normal   (4 float)
+	skipLine(); //debug    (3 float)
+
+	int nbVisible = 0;
+	if (!parseInt(nbVisible))
+		return false;
+	for (int i=0; i<nbVisible; ++i)
+	{
+		int pictureIndex;
+		if (!parseInt(pictureIndex))
+			return false;
+		pictureIndexes.push_back(pictureIndex);
+	}
+
+	//images where texture does not agree: not used
+	int nbDisagree = 0;
+	if (parseInt(nbDisagree))
+	{
+		int pictureIndex;
+		for (int i=0; i<nbDisagree; ++i)
+		{
+			if (!parseInt(pictureIndex))
+				break;
+		}
+	}
+
+	return true;
+}
+
+bool PatchReader::map(boost::uintmax_t offset)
+{
+	delete mRegion;
+	mRegion = NULL;
+
+	std::size_t size = (std::size_t) std::min<boost::uintmax_t>(mWindowSize, mFileSize - offset);
+	if (size == 0)
+		return false;
+
+	try
+	{
+		mRegion = new mapped_region(*mFile, read_only, (offset_t) offset, size);
+	}
+	catch (interprocess_exception&)
+	{
+		mRegion = NULL;
+		return false;
+	}
+
+	mWindowOffset = offset;
+	mBegin = static_cast<const char*>(mRegion->get_address());
+	mEnd   = mBegin + size;
+	mData  = mBegin;
+
+	return true;
+}
+
+bool PatchReader::refill()
+{
+	//slide the window when the next patch could cross its end
+	boost::uintmax_t windowEnd = mWindowOffset + (mEnd - mBegin);
+	if ((std::size_t) (mEnd - mData) >= maxPatchSize || windowEnd >= mFileSize)
+		return true;
+
+	return map(mWindowOffset + (mData - mBegin));
+}
@@ -0,0 +1,161 @@
+/*
+	Copyright (c) 2010 ASTRE Henri (http://www.visual-experiments.com)
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+	THE SOFTWARE.
+*/
+
+#include "PMVSVisibilityMap.h"
+
+#include <algorithm>
+
+namespace
+{
+	bool compareCount(const std::pair<unsigned int, int>& a, const std::pair<unsigned int, int>& b)
+	{
+		if (a.first != b.first)
+			return a.first > b.first;
+		return a.second < b.second;
+	}
+}
+
+VisibilityMap::VisibilityMap(unsigned int nbPicture)
+{
+	mNbPicture = nbPicture;
+	mCounts.resize(nbPicture > 1 ? (std::size_t) nbPicture * (nbPicture - 1) / 2 : 0, 0);
+}
+
+unsigned int VisibilityMap::getNbPicture() const
+{
+	return mNbPicture;
+}
+
+void VisibilityMap::addPatch(const int* pictureIndexes, unsigned int nbIndex)
+{
+	mPictures.clear();
+	for (unsigned int i=0; i<nbIndex; ++i)
+	{
+		if (pictureIndexes[i] >= 0 && pictureIndexes[i] < (int) mNbPicture)
+			mPictures.push_back(pictureIndexes[i]);
+	}
+	std::sort(mPictures.begin(), mPictures.end());
+	mPictures.erase(std::unique(mPictures.begin(), mPictures.end()), mPictures.end());
+
+	for (unsigned int j=0; j+1<mPictures.size(); ++j)
+	{
+		std::size_t row = getIndex(mPictures[j], mPictures[j] + 1) - (mPictures[j] + 1); //mCounts[row + k] = (j, k)
+		for (unsigned int k=j+1; k<mPictures.size(); ++k)
+			mCounts[row + mPictures[k]]++;
+	}
+	mSortedCounts.clear();
+}
+
+void VisibilityMap::merge(const VisibilityMap& map)
+{
+	if (map.mNbPicture != mNbPicture)
+		return;
+
+	for (std::size_t i=0; i<mCounts.size(); ++i)
+		mCounts[i] += map.mCounts[i];
+	mSortedCounts.clear();
+}
+
+std::vector<int> VisibilityMap::getNeighbours(unsigned int picture, int threshold) const
+{
+	std::vector<int> neighbours;
+	for (unsigned int j=0; j<mNbPicture; ++j)
+	{
+		if ((long long) get(picture, j) > threshold)
+			neighbours.push_back(j);
+	}
+
+	return neighbours;
+}
+
+std::vector<int> VisibilityMap::getTopNeighbours(unsigned int picture, unsigned int nbNeighbour) const
+{
+	std::vector<std::pair<unsigned int, int> > counts;
+	for (unsigned int j=0; j<mNbPicture; ++j)
+	{
+		unsigned int count = get(picture, j);
+		if (count > 0)
+			counts.push_back(std::make_pair(count, (int) j));
+	}
+
+	nbNeighbour = std::min(nbNeighbour, (unsigned int) counts.size());
+	std::partial_sort(counts.begin(), counts.begin() + nbNeighbour, counts.end(), compareCount);
+
+	std::vector<int> neighbours(nbNeighbour);
+	for (unsigned int i=0; i<nbNeighbour; ++i)
+		neighbours[i] = counts[i].second;
+	std::sort(neighbours.begin(), neighbours.end());
+
+	return neighbours;
+}
+
+unsigned int VisibilityMap::getDegree(unsigned int picture, int threshold) const
+{
+	unsigned int degree = 0;
+	for (unsigned int j=0; j<mNbPicture; ++j)
+	{
+		if ((long long) get(picture, j) > threshold)
+			degree++;
+	}
+
+	return degree;
+}
+
+std::size_t VisibilityMap::getNbPair(int threshold) const
+{
+	const std::vector<unsigned int>& counts = getSortedCounts();
+	unsigned int minCount = (unsigned int) std::max(threshold, 0);
+
+	return counts.end() - std::upper_bound(counts.begin(), counts.end(), minCount);
+}
+
+int VisibilityMap::getThreshold(double nbNeighbour) const
+{
+	//each pair gives a neighbour to both pictures
+	const std::vector<unsigned int>& counts = getSortedCounts();
+	std::size_t nbPair = (std::size_t) std::max(nbNeighbour * mNbPicture / 2, 0.0);
+	if (nbPair >= counts.size())
+		return 0;
+
+	//the pair ranked nbPair+1 must be dropped, with every pair sharing as many patches
+	return (int) counts[counts.size() - nbPair - 1];
+}
+
+const std::vector<unsigned int>& VisibilityMap::getSortedCounts() const
+{
+	if (mSortedCounts.empty())
+	{
+		for (std::size_t i=0; i<mCounts.size(); ++i)
+		{
+			if (mCounts[i] > 0)
+				mSortedCounts.push_back(mCounts[i]);
+		}
+		std::sort(mSortedCounts.begin(), mSortedCounts.end());
+	}
+
+	return mSortedCounts;
+}
+
+std::size_t VisibilityMap::getMemorySize(unsigned int nbPicture)
+{
+	return nbPicture > 1 ? (std::size_t) nbPicture * (nbPicture - 1) / 2 * sizeof(unsigned int) : 0;
+}
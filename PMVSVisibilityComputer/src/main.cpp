@@ -24,6 +24,88 @@
 #include <fstream>
 #include <string>
 #include <vector>
+#include <algorithm>
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+
+#include "PMVSPatchReader.h"
+#include "PMVSVisibilityMap.h"
+
+static const unsigned int patchBatchSize        = 4096;            //patches read at once by an accumulating thread
+static const std::size_t  visibilityMemoryBudget = 512*1024*1024;  //memory used by the thread-local maps
+
+//read batches of patches and count them into a thread-local map (parsing is serialized, counting is not)
+void accumulatePatches(PatchReader* input, boost::mutex* inputMutex, VisibilityMap* map, unsigned int* nbPatch)
+{
+	std::vector<int> pictureIndexes;
+	std::vector<int> batchIndexes;
+	std::vector<unsigned int> batchCounts;
+	batchCounts.reserve(patchBatchSize);
+
+	while (true)
+	{
+		batchIndexes.clear();
+		batchCounts.clear();
+		{
+			boost::mutex::scoped_lock lock(*inputMutex);
+			while (batchCounts.size() < patchBatchSize && input->readPatch(pictureIndexes))
+			{
+				batchCounts.push_back((unsigned int) pictureIndexes.size());
+				batchIndexes.insert(batchIndexes.end(), pictureIndexes.begin(), pictureIndexes.end());
+			}
+		}
+		if (batchCounts.empty())
+			break;
+
+		unsigned int offset = 0;
+		for (unsigned int i=0; i<batchCounts.size(); ++i)
+		{
+			if (batchCounts[i] > 1)
+				map->addPatch(&batchIndexes[offset], batchCounts[i]);
+			offset += batchCounts[i];
+		}
+		*nbPatch += (unsigned int) batchCounts.size();
+	}
+}
+
+//compact alternative to the nbPicture x nbPicture dump: neighbour counts for a range of thresholds and per picture
+void writeSummary(std::ostream& output, const VisibilityMap& visibilityMap, unsigned int nbPatch, int threshold)
+{
+	unsigned int nbPicture = visibilityMap.getNbPicture();
+	output << "patches;" << nbPatch << std::endl;
+	output << "pictures;" << nbPicture << std::endl;
+	output << "threshold;" << threshold << std::endl;
+	output << std::endl;
+
+	output << "threshold;average neighbours;pairs" << std::endl;
+	int candidate = 0; //0, 1, 2, 5, 10, 20, 50...
+	while (true)
+	{
+		std::size_t nbPair = visibilityMap.getNbPair(candidate);
+		output << candidate << ";" << (nbPicture > 0 ? 2.0 * nbPair / nbPicture : 0) << ";" << nbPair << std::endl;
+		if (nbPair == 0 || candidate > 1000000000)
+			break;
+
+		int digit = candidate;
+		int scale = 1;
+		while (digit >= 10)
+		{
+			digit /= 10;
+			scale *= 10;
+		}
+		candidate = (candidate == 0) ? 1 : (digit == 1 ? 2 : (digit == 2 ? 5 : 10)) * scale;
+	}
+	output << std::endl;
+
+	output << "picture;neighbours;max shared patches" << std::endl;
+	for (unsigned int i=0; i<nbPicture; ++i)
+	{
+		unsigned int maxCount = 0;
+		for (unsigned int j=0; j<nbPicture; ++j)
+			maxCount = std::max(maxCount, visibilityMap.get(i, j));
+		output << i << ";" << visibilityMap.getDegree(i, threshold) << ";" << maxCount << std::endl;
+	}
+}
 
 int main(int argc, char* argv[])
 {
@@ -38,13 +120,16 @@ int main(int argc, char* argv[])
 		std::cout << "<threshold>: 0 is a good value"<<std::endl;
 		std::cout << "	-> -1: very slow but full reconstruction" << std::endl;
 		std::cout << "	-> +infinity: very quick but no reconstruction" << std::endl;
+		std::cout << "	-> top=<K>: keep the K pictures sharing the most patches with each picture" << std::endl;
+		std::cout << "	-> auto=<N>: choose the threshold giving at most N neighbours per picture on average" << std::endl;
 		std::cout << "<dump.csv>: output file optional that help to choose a good threshold" << std::endl;
+		std::cout << "	-> summary=<file>: write neighbour counts per threshold and per picture instead of the full matrix" << std::endl;
 
 		return -1;
 	}	
 
-	std::ifstream input(argv[1]);
-	if (!input.is_open())
+	PatchReader input;
+	if (!input.open(argv[1]))
 	{
 		std::cout << "Failed to open " << argv[1]<< " for reading" <<std::endl;
 		return -1;
@@ -56,62 +141,58 @@ int main(int argc, char* argv[])
 		return -1;
 	}
 
-	int nbPicture = atoi(argv[3]);
-	int threshold = atoi(argv[4]);
-
-	std::vector<std::vector<int>> visibilityMap;
-	visibilityMap = std::vector<std::vector<int>>(nbPicture);
-	for (int i=0; i<nbPicture; ++i)
+	int nbPicture = std::max(atoi(argv[3]), 0);
+	std::string thresholdArgument(argv[4]);
+	bool useTopNeighbours  = (thresholdArgument.substr(0, 4) == "top=");
+	bool useAutoThreshold  = (thresholdArgument.substr(0, 5) == "auto=");
+	int threshold          = (useTopNeighbours || useAutoThreshold) ? 0 : atoi(argv[4]);
+	int nbTopNeighbour     = useTopNeighbours ? std::max(atoi(thresholdArgument.substr(4).c_str()), 0) : 0;
+	double nbAutoNeighbour = useAutoThreshold ? atof(thresholdArgument.substr(5).c_str()) : 0;
+
+	//one map per thread, as many threads as the memory budget allows
+	std::size_t mapSize = std::max(VisibilityMap::getMemorySize(nbPicture), (std::size_t) 1);
+	unsigned int nbThread = std::max(boost::thread::hardware_concurrency(), 1u);
+	nbThread = std::max(std::min(nbThread, (unsigned int) (visibilityMemoryBudget / mapSize)), 1u);
+
+	std::vector<VisibilityMap> maps(nbThread, VisibilityMap(nbPicture));
+	std::vector<unsigned int> nbPatches(nbThread, 0);
+	boost::mutex inputMutex;
+	boost::thread_group threads;
+	for (unsigned int i=0; i<nbThread; ++i)
+		threads.create_thread(boost::bind(&accumulatePatches, &input, &inputMutex, &maps[i], &nbPatches[i]));
+	threads.join_all();
+
+	VisibilityMap& visibilityMap = maps[0];
+	unsigned int nbPatch = nbPatches[0];
+	for (unsigned int i=1; i<nbThread; ++i)
 	{
-		visibilityMap[i] = std::vector<int>(nbPicture);
-		for (int j=0; j<nbPicture; ++j)
-		{
-			visibilityMap[i][j] = 0;
-		}
+		visibilityMap.merge(maps[i]);
+		nbPatch += nbPatches[i];
 	}
+	if (nbPatch != input.getNbPatch())
+		std::cout << "Warning: " << nbPatch << " patches read out of " << input.getNbPatch() << " announced in " << argv[1] << std::endl;
+	input.close();
 
-	std::string line;
-	std::getline(input, line); //PATCHES
-	int nbPatch;
-	input >> nbPatch;
-	std::getline(input, line); //end-of-line
-	
-	for (int i=0; i<nbPatch; ++i)
+	if (useAutoThreshold)
 	{
-		std::getline(input, line); //PATCHS
-		std::getline(input, line); //position (3 float)
-		std::getline(input, line); //normal   (3 float)
-		std::getline(input, line); //debug    (3 float)
-		int nbPictureInWitchPatchIsVisible;
-		input >> nbPictureInWitchPatchIsVisible;
-
-		std::vector<int> pictureIndexes(nbPictureInWitchPatchIsVisible);
-		for (int j=0; j<nbPictureInWitchPatchIsVisible; ++j)
-		{
-			int pictureIndex;
-			input >> pictureIndex;
-			pictureIndexes[j] = pictureIndex;
-		}
+		threshold = visibilityMap.getThreshold(nbAutoNeighbour);
+		std::size_t nbPair = visibilityMap.getNbPair(threshold);
+		std::cout << "Threshold: " << threshold << " (" << (nbPicture > 0 ? 2.0 * nbPair / nbPicture : 0) << " neighbours per picture on average)" << std::endl;
+	}
 
-		for (int j=0; j<(int)pictureIndexes.size()-1; ++j)
-		{
-			int indexA = pictureIndexes[j];
-			for (int k=j+1; k<(int)pictureIndexes.size(); ++k)
-			{				
-				int indexB = pictureIndexes[k];
-				visibilityMap[indexA][indexB]++;
-				visibilityMap[indexB][indexA]++;
-			}
-		}
-		std::getline(input, line); // (not used) end-of-line
-		std::getline(input, line); // (not used) nb picture (texture not agree -> http://grail.cs.washington.edu/software/pmvs/documentation.html)
-		std::getline(input, line); // (not used) picture indexes
-		std::getline(input, line); // (not used) empty line
+	std::string dumpArgument(argc == 6 ? argv[5] : "");
+	if (dumpArgument.substr(0, 8) == "summary=")
+	{
+		std::ofstream summary(dumpArgument.substr(8).c_str());
+		if (!summary.is_open())
+			std::cout << "Failed to open " << dumpArgument.substr(8) << " for writing" <<std::endl;
+		else
+			writeSummary(summary, visibilityMap, nbPatch, threshold);
+		summary.close();
 	}
-	input.close();
 
 	//Writing dump file to help choosing a good threshold
-	if (argc == 6)
+	else if (argc == 6)
 	{
 		std::ofstream dump(argv[5]);
 		if (!dump.is_open())
@@ -121,7 +202,7 @@ int main(int argc, char* argv[])
 			for (int i=0; i<nbPicture; ++i)
 			{
 				for (int j=0; j<nbPicture; ++j)
-					dump << visibilityMap[i][j] << ";";
+					dump << visibilityMap.get(i, j) << ";";
 				dump << std::endl;
 			}
 		}
@@ -133,11 +214,10 @@ int main(int argc, char* argv[])
 	for (int i=0; i<nbPicture; ++i)
 	{
 		std::vector<int> pictureIndexes;
-		for (int j=0; j<nbPicture; ++j)
-		{
-			if (visibilityMap[i][j] > threshold)
-				pictureIndexes.push_back(j);
-		}
+		if (useTopNeighbours)
+			pictureIndexes = visibilityMap.getTopNeighbours(i, nbTopNeighbour);
+		else
+			pictureIndexes = visibilityMap.getNeighbours(i, threshold);
 
 		output << i << " " << pictureIndexes.size() << " ";
 		for (int j=0; j<(int)pictureIndexes.size(); ++j)
@@ -28,6 +28,7 @@
 #include <jpeglib.h>
 
 #include <PhotoSynthImage.h>
+#include <PhotoSynthTextWriter.h>
 
 using namespace PhotoSynth;
 
@@ -96,8 +97,6 @@ void RadialUndistort::saveContourFile(const std::string& inputFolder, unsigned i
 	std::stringstream filepath;
 	filepath << inputFolder << "/pmvs/txt/" << buf << ".txt";
 
-	FILE *f = fopen(filepath.str().c_str(), "w");
-
 	// Compute the projection matrix
 	double focal = camera.focal*std::max(dimension.x, dimension.y);
 	double R[9];
@@ -120,12 +119,19 @@ void RadialUndistort::saveContourFile(const std::string& inputFolder, unsigned i
 	matrix_product(3, 3, 3, 4, K, Ptmp, P);
 	matrix_scale(3, 4, P, -1.0, P);
 
-	fprintf(f, "CONTOUR\n");
-	fprintf(f, "%0.6f %0.6f %0.6f %0.6f\n", P[0], P[1], P[2],  P[3]);
-	fprintf(f, "%0.6f %0.6f %0.6f %0.6f\n", P[4], P[5], P[6],  P[7]);
-	fprintf(f, "%0.6f %0.6f %0.6f %0.6f\n", P[8], P[9], P[10], P[11]);
+	TextWriter output(filepath.str());
+	if (!output.isOpen())
+		return;
 
-	fclose(f);
+	output << "CONTOUR\n";
+	for (unsigned int i=0; i<3; ++i)
+	{
+		for (unsigned int j=0; j<4; ++j)
+		{
+			output.writeFixed(P[4*i + j], 6);
+			output << (j < 3 ? ' ' : '\n');
+		}
+	}
 }
 
 Ogre::Vector2 RadialUndistort::getJpegDimensions(const std::string& filepath)
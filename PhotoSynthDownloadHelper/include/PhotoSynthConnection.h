@@ -0,0 +1,150 @@
+/*
+	Copyright (c) 2010 ASTRE Henri (http://www.visual-experiments.com)
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+	THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <map>
+#include <stdexcept>
+#include <boost/asio.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include "PhotoSynthDownloadPolicy.h"
+#include "PhotoSynthDownloadCache.h"
+
+namespace PhotoSynth
+{
+	class DataSink;
+
+	class HttpError : public std::runtime_error
+	{
+		public:
+			HttpError(unsigned int status);
+
+			//5xx errors may disappear on retry, 4xx won't
+			bool isTransient() const;
+
+			unsigned int status;
+	};
+
+	//Blocking http connection with connect/read deadlines.
+	//Each connection owns its io_service so that deadlines can be enforced from the calling thread.
+	class Connection
+	{
+		public:
+			Connection(const std::string& host, const DownloadPolicy& policy);
+			~Connection();
+
+			void connect();
+			void write(const std::string& request);
+			//read status line and header fields, throw HttpError if the status is not 2xx
+			//or 304 (not modified: answer to a conditional request, see createGETHeader)
+			void readHeader();
+
+			//read the content of the response whose header was just read:
+			//chunked transfer-encoding, Content-Length bytes or until the server closes the connection (none for 304)
+			void readContent(DataSink& sink);
+			void close();
+
+			bool isOpen() const;
+			const std::string& getHost() const;
+
+			//status and cache validators of the response whose header was just read
+			unsigned int getStatus() const;
+			const HttpValidator& getValidator() const;
+
+			//duration of the last connect() in ms: name resolution and tcp handshake
+			unsigned int getResolveTime() const;
+			unsigned int getConnectTime() const;
+
+			static const unsigned int notModified = 304;
+
+		protected:
+			std::string readLine();
+			void readBody(std::size_t length, DataSink& sink);
+			void readUntilEof(DataSink& sink);
+			void wait(boost::system::error_code& error, unsigned int timeout);
+			void onDeadline(const boost::system::error_code& error, bool* expired);
+
+			static void onResolve(const boost::system::error_code& error, boost::asio::ip::tcp::resolver::iterator iterator, boost::system::error_code* result, boost::asio::ip::tcp::resolver::iterator* endpoints);
+			static void onConnect(const boost::system::error_code& error, boost::system::error_code* result);
+			static void onTransfer(const boost::system::error_code& error, std::size_t size, boost::system::error_code* result, std::size_t* transferred);
+
+			std::string mHost;
+			DownloadPolicy mPolicy;
+			unsigned int mResolveTime;
+			unsigned int mConnectTime;
+
+			//current response
+			unsigned int mStatus;
+			HttpValidator mValidator;
+			bool mHasContentLength;
+			std::size_t mContentLength;
+			bool mIsChunked;
+			bool mIsClosing; //the server closes the connection after the response
+
+			boost::asio::io_service mService;
+			boost::asio::ip::tcp::resolver mResolver;
+			boost::asio::ip::tcp::socket mSocket;
+			boost::asio::deadline_timer mDeadline;
+			boost::asio::streambuf mResponse;
+	};
+
+	typedef boost::shared_ptr<Connection> ConnectionPtr;
+
+	struct ConnectionStats
+	{
+		ConnectionStats();
+
+		unsigned int nbConnection; //new connections
+		unsigned int nbReuse;      //idle connections reused
+		double resolveTime;        //ms, sum over new connections
+		double connectTime;        //ms, sum over new connections
+	};
+
+	//keep-alive connections shared by download threads and reused by host
+	class ConnectionPool
+	{
+		public:
+			ConnectionPool(unsigned int maxIdlePerHost = 16, unsigned int idleTimeout = 5000);
+
+			//return an idle connection to host or a new connected one
+			ConnectionPtr acquire(const std::string& host, const DownloadPolicy& policy);
+
+			//connection must have read its last response entirely
+			void release(ConnectionPtr connection);
+
+			ConnectionStats getStats() const;
+
+		protected:
+			struct IdleConnection
+			{
+				ConnectionPtr connection;
+				boost::posix_time::ptime releaseTime;
+			};
+
+			mutable boost::mutex mMutex;
+			ConnectionStats mStats;
+			std::multimap<std::string, IdleConnection> mIdleConnections;
+			unsigned int mMaxIdlePerHost;
+			unsigned int mIdleTimeout; //ms, server may have closed older connections
+	};
+}
@@ -0,0 +1,105 @@
+/*
+	Copyright (c) 2010 ASTRE Henri (http://www.visual-experiments.com)
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+	THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <string>
+#include <map>
+#include <vector>
+#include <iostream>
+#include <boost/cstdint.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace PhotoSynth
+{
+	//cache validators of a response (ETag and Last-Modified headers, as sent by the server)
+	struct HttpValidator
+	{
+		std::string etag;
+		std::string lastModified;
+
+		bool isEmpty() const;
+	};
+
+	//On-disk cache of downloaded files keyed by url, shared by all projects and runs.
+	//Each entry keeps the validators of its response: a hit is revalidated by a conditional request
+	//and only served (by hard-link, or copy when linking fails) when the server answers 304 not modified.
+	//When the cache grows over maxSize the least recently used files are removed.
+	//Thread safe: can be shared by all download threads of a run.
+	class DownloadCache
+	{
+		public:
+			DownloadCache(const std::string& folder, boost::uintmax_t maxSize = defaultMaxSize);
+
+			//command line option: cache=<folder> cachesize=<MB>
+			static bool parseArgument(const std::string& argument, std::string& folder, boost::uintmax_t& maxSize);
+
+			//validators of the cached content of url, return false if url is not cached
+			bool getValidator(const std::string& url, HttpValidator& validator);
+
+			//copy cached content of url to filepath (or buffer) once revalidated, return false if url is not cached anymore
+			bool get(const std::string& url, const std::string& filepath);
+			bool get(const std::string& url, std::vector<char>& buffer);
+
+			//add a completely downloaded file (or buffer) to the cache, ignored without validator (can't be revalidated)
+			void put(const std::string& url, const std::string& filepath, const HttpValidator& validator);
+			void put(const std::string& url, const std::vector<char>& buffer, const HttpValidator& validator);
+
+			unsigned int getNbHit() const;
+			unsigned int getNbMiss() const;
+			void print(std::ostream& output) const;
+
+			static const boost::uintmax_t defaultMaxSize = 4096ULL*1024*1024;
+
+		protected:
+			struct Entry
+			{
+				boost::uintmax_t size;
+				boost::uint64_t lastAccess;
+				HttpValidator validator;
+				unsigned int nbReader; //pinned while its content is copied out of the lock: not evicted nor replaced
+			};
+
+			static std::string getKey(const std::string& url);
+			std::string getEntryPath(const std::string& key) const;
+			std::string getValidatorPath(const std::string& key) const;
+			static bool linkOrCopy(const std::string& from, const std::string& to);
+			std::string createTmpPath(const std::string& entryPath);
+			void commit(const std::string& key, const std::string& tmpPath, boost::uintmax_t size, const HttpValidator& validator);
+			void remove(std::map<std::string, Entry>::iterator it); //called with mMutex locked
+
+			void scan();
+			void evict(); //called with mMutex locked
+
+			std::string mFolder;
+			boost::uintmax_t mMaxSize;
+			boost::uintmax_t mSize;
+			boost::uint64_t mClock;
+			unsigned int mNbTmpFile;
+			unsigned int mNbHit;
+			unsigned int mNbMiss;
+			unsigned int mNbStale;
+			unsigned int mNbEviction;
+			std::map<std::string, Entry> mEntries;
+			mutable boost::mutex mMutex;
+	};
+}
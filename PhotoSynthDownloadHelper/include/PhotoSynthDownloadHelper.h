@@ -22,24 +22,73 @@
 
 #pragma once
 
-#include <boost/asio.hpp>
-
-typedef boost::shared_ptr<boost::asio::ip::tcp::socket> SocketPtr;
+#include <fstream>
+#include <vector>
+#include "PhotoSynthConnection.h"
+#include "PhotoSynthDownloadPolicy.h"
+#include "PhotoSynthDownloadCache.h"
 
 namespace PhotoSynth
 {
+	//receive downloaded content chunk by chunk (no whole-file buffer)
+	class DataSink
+	{
+		public:
+			virtual ~DataSink() {}
+			virtual bool write(const char* data, std::size_t size) = 0;
+			virtual bool reset() = 0; //discard content received by a failed attempt
+	};
+
+	class FileSink : public DataSink
+	{
+		public:
+			FileSink(const std::string& filepath);
+			~FileSink();
+
+			bool isOpen() const;
+			void close();
+			virtual bool write(const char* data, std::size_t size);
+			virtual bool reset();
+
+		protected:
+			std::string mFilePath;
+			std::ofstream mOutput;
+	};
+
+	//keep downloaded content in memory (small files decoded right after download)
+	class MemorySink : public DataSink
+	{
+		public:
+			MemorySink(std::vector<char>& buffer);
+
+			virtual bool write(const char* data, std::size_t size);
+			virtual bool reset();
+
+		protected:
+			std::vector<char>& mBuffer;
+	};
+
 	class DownloadHelper
 	{
 		public:
-			//socket helper
-			static SocketPtr connect(boost::asio::io_service* service, const std::string& url);
+			//url helper
 			static std::string extractHost(const std::string& url);
 			static std::string removeHost(const std::string& url, const std::string& host);
-			static std::string createGETHeader(const std::string& get, const std::string& host = "");
-			static unsigned int getContentLength(std::istream& header);
+			static std::string createGETHeader(const std::string& get, const std::string& host = "", const HttpValidator& validator = HttpValidator()); //conditional GET when validator is given
+
+			//download helper: retry failed attempts according to policy, failures are added to report
+			//connections are reused when a pool is given, cached GET requests are revalidated (304 Not Modified) before being reused
+			//status and validator (optional) receive the response status and ETag/Last-Modified on success
+			static bool fetch(const std::string& url, DataSink& sink, const DownloadPolicy& policy, DownloadReport* report = NULL, ConnectionPool* pool = NULL);
+			static bool fetch(const std::string& host, const std::string& request, const std::string& description, DataSink& sink, const DownloadPolicy& policy, DownloadReport* report = NULL, ConnectionPool* pool = NULL, unsigned int* status = NULL, HttpValidator* validator = NULL);
+			static bool fetchFile(const std::string& url, const std::string& filepath, const DownloadPolicy& policy, DownloadReport* report = NULL, ConnectionPool* pool = NULL, DownloadCache* cache = NULL);
+			static bool fetchFile(const std::string& host, const std::string& request, const std::string& description, const std::string& filepath, const DownloadPolicy& policy, DownloadReport* report = NULL, ConnectionPool* pool = NULL, unsigned int* status = NULL, HttpValidator* validator = NULL);
+			static bool fetchBuffer(const std::string& url, std::vector<char>& buffer, const DownloadPolicy& policy, DownloadReport* report = NULL, ConnectionPool* pool = NULL, DownloadCache* cache = NULL);
+			static void waitBeforeRetry(const DownloadPolicy& policy, unsigned int attempt);
 
 			//file helper			
 			static bool saveAsciiFile(const std::string& filepath, const std::string& content);
-			static bool saveBinFile(const std::string& filepath, std::istream& input, unsigned int length);						
+
+			static const unsigned int chunkSize = 64*1024;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,79 @@
+/*
+	Copyright (c) 2010 ASTRE Henri (http://www.visual-experiments.com)
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+	THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <boost/thread/mutex.hpp>
+
+namespace PhotoSynth
+{
+	struct DownloadPolicy
+	{
+		DownloadPolicy();
+
+		//command line option: timeout=<ms> attempts=<n> backoff=<ms>
+		bool parseArgument(const std::string& argument);
+
+		//delay before retrying after failed attempt n (exponential backoff with jitter)
+		unsigned int getBackoff(unsigned int attempt) const;
+
+		unsigned int connectTimeout; //ms
+		unsigned int readTimeout;    //ms without receiving any byte
+		unsigned int maxAttempts;
+		unsigned int initialBackoff; //ms
+		unsigned int maxBackoff;     //ms
+	};
+
+	struct DownloadFailure
+	{
+		DownloadFailure(const std::string& url, const std::string& reason, unsigned int nbAttempt);
+
+		std::string url;
+		std::string reason;
+		unsigned int nbAttempt;
+	};
+
+	//thread safe: shared by all download threads of a run
+	class DownloadReport
+	{
+		public:
+			DownloadReport();
+
+			void addSuccess(unsigned int nbAttempt);
+			void addFailure(const std::string& url, const std::string& reason, unsigned int nbAttempt);
+
+			unsigned int getNbSuccess() const;
+			unsigned int getNbFailure() const;
+
+			void print(std::ostream& output) const;
+			bool save(const std::string& filepath) const;
+
+		protected:
+			mutable boost::mutex mMutex;
+			unsigned int mNbSuccess;
+			unsigned int mNbRetry;
+			std::vector<DownloadFailure> mFailures;
+	};
+}
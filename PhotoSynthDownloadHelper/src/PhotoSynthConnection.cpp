@@ -0,0 +1,435 @@
+/*
+	Copyright (c) 2010 ASTRE Henri (http://www.visual-experiments.com)
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+	THE SOFTWARE.
+*/
+
+#include "PhotoSynthConnection.h"
+#include "PhotoSynthDownloadHelper.h"
+
+#include <sstream>
+#include <cstdlib>
+#include <boost/bind.hpp>
+#include <boost/algorithm/string.hpp>
+
+using namespace PhotoSynth;
+using boost::asio::ip::tcp;
+
+const unsigned int Connection::notModified;
+
+static std::string getHttpErrorMessage(unsigned int status)
+{
+	std::stringstream message;
+	message << "HTTP status " << status;
+
+	return message.str();
+}
+
+HttpError::HttpError(unsigned int status)
+: std::runtime_error(getHttpErrorMessage(status))
+{
+	this->status = status;
+}
+
+bool HttpError::isTransient() const
+{
+	return status >= 500;
+}
+
+Connection::Connection(const std::string& host, const DownloadPolicy& policy)
+: mResolver(mService), mSocket(mService), mDeadline(mService)
+{
+	mHost             = host;
+	mPolicy           = policy;
+	mResolveTime      = 0;
+	mConnectTime      = 0;
+	mStatus           = 0;
+	mHasContentLength = false;
+	mContentLength    = 0;
+	mIsChunked        = false;
+	mIsClosing        = false;
+}
+
+Connection::~Connection()
+{
+	close();
+}
+
+bool Connection::isOpen() const
+{
+	return mSocket.is_open();
+}
+
+const std::string& Connection::getHost() const
+{
+	return mHost;
+}
+
+unsigned int Connection::getStatus() const
+{
+	return mStatus;
+}
+
+const HttpValidator& Connection::getValidator() const
+{
+	return mValidator;
+}
+
+unsigned int Connection::getResolveTime() const
+{
+	return mResolveTime;
+}
+
+unsigned int Connection::getConnectTime() const
+{
+	return mConnectTime;
+}
+
+void Connection::connect()
+{
+	boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+
+	//name resolution shares the connect deadline
+	tcp::resolver::query query(mHost, "http");
+	tcp::resolver::iterator endpoint_iterator;
+	tcp::resolver::iterator end;
+
+	boost::system::error_code error = boost::asio::error::would_block;
+	mResolver.async_resolve(query, boost::bind(&Connection::onResolve, boost::asio::placeholders::error, boost::asio::placeholders::iterator, &error, &endpoint_iterator));
+	wait(error, mPolicy.connectTimeout);
+	if (error)
+		throw boost::system::system_error(error);
+
+	boost::posix_time::ptime resolved = boost::posix_time::microsec_clock::universal_time();
+	mResolveTime = (unsigned int) (resolved - start).total_milliseconds();
+
+	error = boost::asio::error::host_not_found;
+	while (error && endpoint_iterator != end)
+	{
+		mSocket.close();
+
+		error = boost::asio::error::would_block;
+		mSocket.async_connect(*endpoint_iterator++, boost::bind(&Connection::onConnect, boost::asio::placeholders::error, &error));
+		wait(error, mPolicy.connectTimeout);
+	}
+	if (error)
+		throw boost::system::system_error(error);
+
+	mConnectTime = (unsigned int) (boost::posix_time::microsec_clock::universal_time() - resolved).total_milliseconds();
+
+	boost::asio::socket_base::keep_alive keepAlive(true);
+	mSocket.set_option(keepAlive);
+}
+
+void Connection::write(const std::string& request)
+{
+	boost::system::error_code error = boost::asio::error::would_block;
+	std::size_t size = 0;
+	boost::asio::async_write(mSocket, boost::asio::buffer(request), boost::bind(&Connection::onTransfer, boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred, &error, &size));
+	wait(error, mPolicy.readTimeout);
+
+	if (error)
+		throw boost::system::system_error(error);
+}
+
+void Connection::readHeader()
+{
+	//read_until may also read the beginning of the content: it stays in mResponse for readContent
+	boost::system::error_code error = boost::asio::error::would_block;
+	std::size_t size = 0;
+	boost::asio::async_read_until(mSocket, mResponse, "\r\n\r\n", boost::bind(&Connection::onTransfer, boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred, &error, &size));
+	wait(error, mPolicy.readTimeout);
+
+	if (error)
+		throw boost::system::system_error(error);
+
+	//example: "HTTP/1.1 200 OK" -> 200
+	std::istream header(&mResponse);
+	std::string line;
+	std::getline(header, line);
+
+	std::stringstream statusLine(line);
+	std::string version;
+	mStatus = 0;
+	statusLine >> version >> mStatus;
+
+	//header field names are case-insensitive (values aren't: ETag is kept as is)
+	mValidator        = HttpValidator();
+	mHasContentLength = false;
+	mContentLength    = 0;
+	mIsChunked        = false;
+	mIsClosing        = (version == "HTTP/1.0");
+	while (std::getline(header, line) && line != "\r" && !line.empty())
+	{
+		std::string::size_type colon = line.find(':');
+		if (colon == std::string::npos)
+			continue;
+
+		std::string name  = boost::algorithm::to_lower_copy(boost::algorithm::trim_copy(line.substr(0, colon)));
+		std::string value = boost::algorithm::trim_copy(line.substr(colon+1));
+		if (name == "content-length")
+		{
+			mHasContentLength = true;
+			mContentLength    = (std::size_t) strtoul(value.c_str(), NULL, 10);
+		}
+		else if (name == "transfer-encoding")
+			mIsChunked = (boost::algorithm::to_lower_copy(value).find("chunked") != std::string::npos);
+		else if (name == "connection")
+			mIsClosing = (boost::algorithm::to_lower_copy(value) == "close");
+		else if (name == "etag")
+			mValidator.etag = value;
+		else if (name == "last-modified")
+			mValidator.lastModified = value;
+	}
+
+	if ((mStatus < 200 || mStatus >= 300) && mStatus != notModified)
+		throw HttpError(mStatus);
+}
+
+void Connection::readContent(DataSink& sink)
+{
+	if (mStatus == notModified)
+	{
+		//no content, even with a Content-Length (length of the cached copy)
+	}
+	else if (mIsChunked)
+	{
+		//example: "1a2b;extension\r\n" + 0x1a2b bytes + "\r\n", last chunk "0\r\n" then trailer fields and "\r\n"
+		while (true)
+		{
+			std::string line = readLine();
+			char* end = NULL;
+			std::size_t size = (std::size_t) strtoul(line.c_str(), &end, 16);
+			if (end == line.c_str())
+				throw std::runtime_error("invalid chunk size");
+			if (size == 0)
+				break;
+
+			readBody(size, sink);
+			readLine(); //end of chunk
+		}
+		while (!readLine().empty()) {}
+	}
+	else if (mHasContentLength)
+		readBody(mContentLength, sink);
+	else
+	{
+		readUntilEof(sink);
+		mIsClosing = true;
+	}
+
+	//the connection can't be reused: close it so that ConnectionPool::release drops it
+	if (mIsClosing)
+		close();
+}
+
+std::string Connection::readLine()
+{
+	boost::system::error_code error = boost::asio::error::would_block;
+	std::size_t size = 0;
+	boost::asio::async_read_until(mSocket, mResponse, "\r\n", boost::bind(&Connection::onTransfer, boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred, &error, &size));
+	wait(error, mPolicy.readTimeout);
+
+	if (error)
+		throw boost::system::system_error(error);
+
+	std::istream input(&mResponse);
+	std::string line;
+	std::getline(input, line);
+	if (!line.empty() && line[line.size()-1] == '\r')
+		line.erase(line.size()-1);
+
+	return line;
+}
+
+void Connection::readBody(std::size_t length, DataSink& sink)
+{
+	std::size_t remaining = length;
+
+	//content already received with the header
+	std::size_t buffered = std::min(mResponse.size(), remaining);
+	if (buffered > 0)
+	{
+		const char* data = boost::asio::buffer_cast<const char*>(mResponse.data());
+		if (!sink.write(data, buffered))
+			throw std::runtime_error("failed to write content");
+		mResponse.consume(buffered);
+		remaining -= buffered;
+	}
+
+	//then socket -> sink by fixed size chunk, the deadline is reset for each chunk
+	char buffer[DownloadHelper::chunkSize];
+	while (remaining > 0)
+	{
+		boost::system::error_code error = boost::asio::error::would_block;
+		std::size_t size = 0;
+		mSocket.async_read_some(boost::asio::buffer(buffer, std::min(remaining, sizeof(buffer))), boost::bind(&Connection::onTransfer, boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred, &error, &size));
+		wait(error, mPolicy.readTimeout);
+
+		if (error)
+			throw boost::system::system_error(error);
+
+		if (!sink.write(buffer, size))
+			throw std::runtime_error("failed to write content");
+		remaining -= size;
+	}
+}
+
+void Connection::readUntilEof(DataSink& sink)
+{
+	if (mResponse.size() > 0)
+	{
+		const char* data = boost::asio::buffer_cast<const char*>(mResponse.data());
+		if (!sink.write(data, mResponse.size()))
+			throw std::runtime_error("failed to write content");
+		mResponse.consume(mResponse.size());
+	}
+
+	char buffer[DownloadHelper::chunkSize];
+	while (true)
+	{
+		boost::system::error_code error = boost::asio::error::would_block;
+		std::size_t size = 0;
+		mSocket.async_read_some(boost::asio::buffer(buffer, sizeof(buffer)), boost::bind(&Connection::onTransfer, boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred, &error, &size));
+		wait(error, mPolicy.readTimeout);
+
+		if (size > 0 && !sink.write(buffer, size))
+			throw std::runtime_error("failed to write content");
+		if (error == boost::asio::error::eof)
+			break;
+		if (error)
+			throw boost::system::system_error(error);
+	}
+}
+
+void Connection::close()
+{
+	boost::system::error_code error;
+	mSocket.close(error);
+}
+
+void Connection::wait(boost::system::error_code& error, unsigned int timeout)
+{
+	bool expired = false;
+	mDeadline.expires_from_now(boost::posix_time::milliseconds(timeout));
+	mDeadline.async_wait(boost::bind(&Connection::onDeadline, this, boost::asio::placeholders::error, &expired));
+
+	//run handlers until the pending operation completes (or is aborted by the deadline)
+	mService.reset();
+	do mService.run_one(); while (error == boost::asio::error::would_block);
+
+	//flush the deadline handler
+	mDeadline.cancel();
+	mService.run();
+
+	if (expired)
+		error = boost::asio::error::timed_out;
+}
+
+void Connection::onDeadline(const boost::system::error_code& error, bool* expired)
+{
+	if (error != boost::asio::error::operation_aborted)
+	{
+		*expired = true;
+		mResolver.cancel();
+		close(); //abort the pending operation
+	}
+}
+
+void Connection::onResolve(const boost::system::error_code& error, tcp::resolver::iterator iterator, boost::system::error_code* result, tcp::resolver::iterator* endpoints)
+{
+	*result    = error;
+	*endpoints = iterator;
+}
+
+void Connection::onConnect(const boost::system::error_code& error, boost::system::error_code* result)
+{
+	*result = error;
+}
+
+void Connection::onTransfer(const boost::system::error_code& error, std::size_t size, boost::system::error_code* result, std::size_t* transferred)
+{
+	*result      = error;
+	*transferred = size;
+}
+
+ConnectionPool::ConnectionPool(unsigned int maxIdlePerHost, unsigned int idleTimeout)
+{
+	mMaxIdlePerHost = maxIdlePerHost;
+	mIdleTimeout    = idleTimeout;
+}
+
+ConnectionPtr ConnectionPool::acquire(const std::string& host, const DownloadPolicy& policy)
+{
+	{
+		boost::mutex::scoped_lock lock(mMutex);
+		boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+
+		std::multimap<std::string, IdleConnection>::iterator it = mIdleConnections.find(host);
+		while (it != mIdleConnections.end() && it->first == host)
+		{
+			IdleConnection idle = it->second;
+			mIdleConnections.erase(it++);
+			if (now - idle.releaseTime < boost::posix_time::milliseconds(mIdleTimeout))
+			{
+				mStats.nbReuse++;
+				return idle.connection;
+			}
+		}
+	}
+
+	ConnectionPtr connection(new Connection(host, policy));
+	connection->connect();
+
+	boost::mutex::scoped_lock lock(mMutex);
+	mStats.nbConnection++;
+	mStats.resolveTime += connection->getResolveTime();
+	mStats.connectTime += connection->getConnectTime();
+
+	return connection;
+}
+
+void ConnectionPool::release(ConnectionPtr connection)
+{
+	if (!connection->isOpen())
+		return;
+
+	boost::mutex::scoped_lock lock(mMutex);
+	if (mIdleConnections.count(connection->getHost()) < mMaxIdlePerHost)
+	{
+		IdleConnection idle;
+		idle.connection  = connection;
+		idle.releaseTime = boost::posix_time::microsec_clock::universal_time();
+		mIdleConnections.insert(std::make_pair(connection->getHost(), idle));
+	}
+}
+
+ConnectionStats ConnectionPool::getStats() const
+{
+	boost::mutex::scoped_lock lock(mMutex);
+	return mStats;
+}
+
+ConnectionStats::ConnectionStats()
+{
+	nbConnection = 0;
+	nbReuse      = 0;
+	resolveTime  = 0;
+	connectTime  = 0;
+}
@@ -0,0 +1,507 @@
+/*
+	Copyright (c) 2010 ASTRE Henri (http://www.visual-experiments.com)
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+	THE SOFTWARE.
+*/
+
+#include "PhotoSynthDownloadCache.h"
+
+#include <sstream>
+#include <fstream>
+#include <iomanip>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include <cstdio>
+#include <ctime>
+#include <boost/filesystem/operations.hpp>
+
+using namespace PhotoSynth;
+namespace bf = boost::filesystem;
+
+namespace
+{
+	const std::string entryExtension     = ".cache";
+	const std::string validatorExtension = ".validator";
+	const std::string tmpExtension       = ".tmp";
+
+	bool hasSuffix(const std::string& text, const std::string& suffix)
+	{
+		return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+	}
+
+	//validator file: etag line then last-modified line
+	bool readValidator(const std::string& filepath, HttpValidator& validator)
+	{
+		std::ifstream input(filepath.c_str());
+		if (!input.is_open())
+			return false;
+
+		std::getline(input, validator.etag);
+		std::getline(input, validator.lastModified);
+
+		return !validator.isEmpty();
+	}
+
+	bool writeValidator(const std::string& filepath, const HttpValidator& validator)
+	{
+		std::ofstream output(filepath.c_str());
+		output << validator.etag << "\n" << validator.lastModified << "\n";
+
+		return output.good();
+	}
+
+	bool olderAccess(const std::pair<boost::uint64_t, std::string>& a, const std::pair<boost::uint64_t, std::string>& b)
+	{
+		return a.first < b.first;
+	}
+}
+
+bool HttpValidator::isEmpty() const
+{
+	return etag.empty() && lastModified.empty();
+}
+
+DownloadCache::DownloadCache(const std::string& folder, boost::uintmax_t maxSize)
+{
+	mFolder     = folder;
+	mMaxSize    = maxSize;
+	mSize       = 0;
+	mClock      = 0;
+	mNbTmpFile  = 0;
+	mNbHit      = 0;
+	mNbMiss     = 0;
+	mNbStale    = 0;
+	mNbEviction = 0;
+
+	if (!bf::exists(mFolder))
+		bf::create_directories(mFolder);
+
+	scan();
+}
+
+bool DownloadCache::parseArgument(const std::string& argument, std::string& folder, boost::uintmax_t& maxSize)
+{
+	std::string::size_type separator = argument.find('=');
+	if (separator == std::string::npos)
+		return false;
+
+	std::string name  = argument.substr(0, separator);
+	std::string value = argument.substr(separator+1);
+
+	if (name == "cache")
+		folder = value;
+	else if (name == "cachesize")
+		maxSize = (boost::uintmax_t) atoi(value.c_str()) * 1024 * 1024;
+	else
+		return false;
+
+	return true;
+}
+
+bool DownloadCache::getValidator(const std::string& url, HttpValidator& validator)
+{
+	std::string key = getKey(url);
+
+	boost::mutex::scoped_lock lock(mMutex);
+
+	std::map<std::string, Entry>::iterator it = mEntries.find(key);
+	if (it == mEntries.end())
+	{
+		mNbMiss++;
+		return false;
+	}
+
+	validator = it->second.validator;
+	return true;
+}
+
+bool DownloadCache::get(const std::string& url, const std::string& filepath)
+{
+	std::string key = getKey(url);
+	std::string entryPath = getEntryPath(key);
+
+	//pin the entry under lock, link or copy it without blocking the other download threads
+	{
+		boost::mutex::scoped_lock lock(mMutex);
+
+		std::map<std::string, Entry>::iterator it = mEntries.find(key);
+		if (it == mEntries.end())
+			return false;
+		it->second.nbReader++;
+	}
+
+	bool linked = linkOrCopy(entryPath, filepath);
+	if (linked)
+	{
+		try
+		{
+			//keep LRU order for the next runs
+			bf::last_write_time(entryPath, std::time(NULL));
+		}
+		catch (std::exception&) {}
+	}
+
+	boost::mutex::scoped_lock lock(mMutex);
+
+	//a pinned entry is still there
+	std::map<std::string, Entry>::iterator it = mEntries.find(key);
+	it->second.nbReader--;
+	if (!linked)
+	{
+		//entry removed behind our back
+		if (it->second.nbReader == 0)
+			remove(it);
+		return false;
+	}
+
+	it->second.lastAccess = ++mClock;
+	mNbHit++;
+	return true;
+}
+
+bool DownloadCache::get(const std::string& url, std::vector<char>& buffer)
+{
+	std::string key = getKey(url);
+	std::string entryPath = getEntryPath(key);
+
+	boost::uintmax_t size = 0;
+	{
+		boost::mutex::scoped_lock lock(mMutex);
+
+		std::map<std::string, Entry>::iterator it = mEntries.find(key);
+		if (it == mEntries.end())
+			return false;
+		it->second.nbReader++;
+		size = it->second.size;
+	}
+
+	bool read = false;
+	{
+		std::ifstream input(entryPath.c_str(), std::ios::binary);
+		buffer.resize((std::size_t) size);
+		read = input.is_open() && (buffer.empty() || input.read(&buffer[0], buffer.size()));
+	}
+	if (read)
+	{
+		try
+		{
+			bf::last_write_time(entryPath, std::time(NULL));
+		}
+		catch (std::exception&) {}
+	}
+
+	boost::mutex::scoped_lock lock(mMutex);
+
+	std::map<std::string, Entry>::iterator it = mEntries.find(key);
+	it->second.nbReader--;
+	if (!read)
+	{
+		buffer.clear();
+		if (it->second.nbReader == 0)
+			remove(it);
+		return false;
+	}
+
+	it->second.lastAccess = ++mClock;
+	mNbHit++;
+	return true;
+}
+
+void DownloadCache::put(const std::string& url, const std::string& filepath, const HttpValidator& validator)
+{
+	if (validator.isEmpty())
+		return;
+
+	std::string key = getKey(url);
+	std::string tmpPath;
+
+	try
+	{
+		boost::uintmax_t size = bf::file_size(filepath);
+		if (size > mMaxSize)
+			return;
+
+		//copy outside of the lock, the entry only becomes visible once complete
+		tmpPath = createTmpPath(getEntryPath(key));
+		if (!linkOrCopy(filepath, tmpPath))
+			return;
+
+		commit(key, tmpPath, size, validator);
+	}
+	catch (std::exception&)
+	{
+		//the cache is optional: a failure only means a future miss
+		if (!tmpPath.empty())
+			std::remove(tmpPath.c_str());
+	}
+}
+
+void DownloadCache::put(const std::string& url, const std::vector<char>& buffer, const HttpValidator& validator)
+{
+	if (buffer.size() > mMaxSize || validator.isEmpty())
+		return;
+
+	std::string key = getKey(url);
+	std::string tmpPath;
+
+	try
+	{
+		tmpPath = createTmpPath(getEntryPath(key));
+		{
+			std::ofstream output(tmpPath.c_str(), std::ios::binary);
+			if (!buffer.empty())
+				output.write(&buffer[0], buffer.size());
+			if (!output.good())
+			{
+				output.close();
+				std::remove(tmpPath.c_str());
+				return;
+			}
+		}
+
+		commit(key, tmpPath, buffer.size(), validator);
+	}
+	catch (std::exception&)
+	{
+		if (!tmpPath.empty())
+			std::remove(tmpPath.c_str());
+	}
+}
+
+unsigned int DownloadCache::getNbHit() const
+{
+	boost::mutex::scoped_lock lock(mMutex);
+	return mNbHit;
+}
+
+unsigned int DownloadCache::getNbMiss() const
+{
+	boost::mutex::scoped_lock lock(mMutex);
+	return mNbMiss;
+}
+
+void DownloadCache::print(std::ostream& output) const
+{
+	boost::mutex::scoped_lock lock(mMutex);
+	output << "Cache " << mFolder << ": " << mNbHit << " hits, " << mNbMiss << " misses, " << mNbStale << " stale, ";
+	output << mNbEviction << " evictions, " << mEntries.size() << " files (" << mSize/(1024*1024) << " MB / " << mMaxSize/(1024*1024) << " MB)" << std::endl;
+}
+
+std::string DownloadCache::getKey(const std::string& url)
+{
+	//FNV-1a 64 bits
+	boost::uint64_t hash = 14695981039346656037ULL;
+	for (std::string::size_type i=0; i<url.size(); ++i)
+	{
+		hash ^= (unsigned char) url[i];
+		hash *= 1099511628211ULL;
+	}
+
+	std::stringstream key;
+	key << std::hex << std::setw(16) << std::setfill('0') << hash;
+
+	return key.str();
+}
+
+std::string DownloadCache::getEntryPath(const std::string& key) const
+{
+	return (bf::path(mFolder) / (key + entryExtension)).string();
+}
+
+std::string DownloadCache::getValidatorPath(const std::string& key) const
+{
+	return (bf::path(mFolder) / (key + validatorExtension)).string();
+}
+
+bool DownloadCache::linkOrCopy(const std::string& from, const std::string& to)
+{
+	try
+	{
+		if (bf::exists(to))
+			bf::remove(to);
+	}
+	catch (std::exception&)
+	{
+		return false;
+	}
+
+	try
+	{
+		bf::create_hard_link(from, to);
+		return true;
+	}
+	catch (std::exception&) {} //different volume or no hard link support
+
+	try
+	{
+		bf::copy_file(from, to);
+		return true;
+	}
+	catch (std::exception&)
+	{
+		return false;
+	}
+}
+
+std::string DownloadCache::createTmpPath(const std::string& entryPath)
+{
+	boost::mutex::scoped_lock lock(mMutex);
+
+	std::stringstream path;
+	path << entryPath << "." << mNbTmpFile++ << tmpExtension;
+
+	return path.str();
+}
+
+void DownloadCache::commit(const std::string& key, const std::string& tmpPath, boost::uintmax_t size, const HttpValidator& validator)
+{
+	boost::mutex::scoped_lock lock(mMutex);
+
+	std::map<std::string, Entry>::iterator it = mEntries.find(key);
+	if (it != mEntries.end())
+	{
+		//being copied by another thread: keep it, a stale copy will be replaced by the next download
+		if (it->second.nbReader > 0)
+		{
+			std::remove(tmpPath.c_str());
+			return;
+		}
+
+		//the remote file has changed since it was cached
+		if (it->second.validator.etag != validator.etag || it->second.validator.lastModified != validator.lastModified)
+			mNbStale++;
+		mSize -= it->second.size;
+		mEntries.erase(it);
+	}
+
+	std::string entryPath = getEntryPath(key);
+	if (bf::exists(entryPath))
+		bf::remove(entryPath);
+	if (!writeValidator(getValidatorPath(key), validator))
+	{
+		std::remove(tmpPath.c_str());
+		return;
+	}
+	bf::rename(tmpPath, entryPath);
+
+	Entry entry;
+	entry.size       = size;
+	entry.lastAccess = ++mClock;
+	entry.validator  = validator;
+	entry.nbReader   = 0;
+	mEntries[key]    = entry;
+	mSize           += size;
+
+	evict();
+}
+
+void DownloadCache::remove(std::map<std::string, Entry>::iterator it)
+{
+	try
+	{
+		bf::remove(getEntryPath(it->first));
+		bf::remove(getValidatorPath(it->first));
+	}
+	catch (std::exception&) {}
+
+	mSize -= it->second.size;
+	mEntries.erase(it);
+}
+
+void DownloadCache::scan()
+{
+	//rebuild index from previous runs: LRU order comes from last write time
+	std::vector<std::pair<std::time_t, std::string> > files;
+
+	bf::directory_iterator itEnd;
+	for (bf::directory_iterator it(mFolder); it != itEnd; ++it)
+	{
+		if (bf::is_directory(it->status()))
+			continue;
+
+		std::string filepath = it->path().string();
+		if (hasSuffix(filepath, tmpExtension))
+		{
+			//interrupted put
+			bf::remove(it->path());
+			continue;
+		}
+		if (hasSuffix(filepath, validatorExtension))
+		{
+			//validator of an entry removed behind our back
+			std::string entryPath = filepath.substr(0, filepath.size() - validatorExtension.size()) + entryExtension;
+			if (!bf::exists(entryPath))
+				bf::remove(it->path());
+			continue;
+		}
+		if (!hasSuffix(filepath, entryExtension))
+			continue;
+
+		files.push_back(std::make_pair(bf::last_write_time(it->path()), filepath));
+	}
+	std::sort(files.begin(), files.end());
+
+	for (unsigned int i=0; i<files.size(); ++i)
+	{
+		const std::string& filepath = files[i].second;
+		std::string filename = filepath.substr(filepath.find_last_of("/\\") + 1);
+		std::string key = filename.substr(0, filename.size() - entryExtension.size());
+
+		//entries without validator can't be revalidated (older cache): dropped
+		Entry entry;
+		if (!readValidator(getValidatorPath(key), entry.validator))
+		{
+			bf::remove(filepath);
+			bf::remove(getValidatorPath(key));
+			continue;
+		}
+		entry.size       = bf::file_size(filepath);
+		entry.lastAccess = ++mClock;
+		entry.nbReader   = 0;
+		mEntries[key]    = entry;
+		mSize           += entry.size;
+	}
+
+	evict();
+}
+
+void DownloadCache::evict()
+{
+	if (mSize <= mMaxSize)
+		return;
+
+	std::vector<std::pair<boost::uint64_t, std::string> > entries;
+	for (std::map<std::string, Entry>::const_iterator it = mEntries.begin(); it != mEntries.end(); ++it)
+		entries.push_back(std::make_pair(it->second.lastAccess, it->first));
+	std::sort(entries.begin(), entries.end(), olderAccess);
+
+	//remove least recently used entries down to 90% of the cap to avoid evicting at each put
+	boost::uintmax_t target = mMaxSize - mMaxSize/10;
+	for (unsigned int i=0; i<entries.size() && mSize > target; ++i)
+	{
+		//pinned entries are being copied: evicted later
+		std::map<std::string, Entry>::iterator it = mEntries.find(entries[i].second);
+		if (it->second.nbReader > 0)
+			continue;
+
+		remove(it);
+		mNbEviction++;
+	}
+}
@@ -23,8 +23,10 @@
 #include "PhotoSynthDownloadHelper.h"
 #include <OgreStringVector.h>
 
+#include <cstdio>
+#include <boost/thread/thread.hpp>
+
 using namespace PhotoSynth;
-using boost::asio::ip::tcp;
 
 //url should be like http://toto.net/index.html -> return toto.net
 std::string DownloadHelper::extractHost(const std::string& url)
@@ -44,28 +46,7 @@ std::string DownloadHelper::removeHost(const std::string& url, const std::string
 	return url.substr(domain.size()+std::string("http://").size());
 }
 
-SocketPtr DownloadHelper::connect(boost::asio::io_service* service, const std::string& url)
-{
-	tcp::resolver resolver(*(service));
-	tcp::resolver::query query(url, "http");
-
-	tcp::resolver::iterator endpoint_iterator = resolver.resolve(query);
-	tcp::resolver::iterator end;
-
-	SocketPtr socket = SocketPtr(new tcp::socket(*(service)));
-	boost::system::error_code error = boost::asio::error::host_not_found;
-	while (error && endpoint_iterator != end)
-	{
-		socket->close();
-		socket->connect(*endpoint_iterator++, error);
-	}
-	if (error)
-		throw boost::system::system_error(error);
-
-	return socket;
-}
-
-std::string DownloadHelper::createGETHeader(const std::string& get, const std::string& host)
+std::string DownloadHelper::createGETHeader(const std::string& get, const std::string& host, const HttpValidator& validator)
 {
 	std::stringstream header;
 	header << "GET " << get << " HTTP/1.1" <<std::endl;
@@ -74,27 +55,15 @@ std::string DownloadHelper::createGETHeader(const std::string& get, const std::s
 	header << "Accept-Language: fr,fr-fr;q=0.8,en-us;q=0.5,en;q=0.3"<<std::endl;
 	header << "Accept-Charset: ISO-8859-1,utf-8;q=0.7,*;q=0.7"<<std::endl;
 	header << "Connection: keep-alive"<<std::endl;
+	if (!validator.etag.empty())
+		header << "If-None-Match: " << validator.etag <<std::endl;
+	if (!validator.lastModified.empty())
+		header << "If-Modified-Since: " << validator.lastModified <<std::endl;
 	header << ""<<std::endl;
 
 	return header.str();
 }
 
-unsigned int DownloadHelper::getContentLength(std::istream& header)
-{
-	//example: "Content-Length: 3789" -> 3789
-
-	int length = 0;
-	std::string contentLength = "Content-Length: ";
-	std::string line;
-	while (std::getline(header, line) && line != "\r")
-	{
-		std::string name = line.substr(0, contentLength.size());
-		if (name == contentLength)
-			length = atoi(Ogre::StringUtil::split(line, contentLength)[0].c_str());
-	}
-	return length;
-}
-
 bool DownloadHelper::saveAsciiFile(const std::string& filepath, const std::string& content)
 {
 	std::ofstream output;
@@ -109,16 +78,215 @@ bool DownloadHelper::saveAsciiFile(const std::string& filepath, const std::strin
 	return opened;
 }
 
-bool DownloadHelper::saveBinFile(const std::string& filepath, std::istream& input, unsigned int length)
+bool DownloadHelper::fetch(const std::string& url, DataSink& sink, const DownloadPolicy& policy, DownloadReport* report, ConnectionPool* pool)
 {
-	char* buffer = new char[length];
-	std::ofstream output;
-	output.open(filepath.c_str(), std::ios::binary);
-	input.read(buffer, length);
-	output.write(buffer, length);
-	output.close();
+	std::string host = extractHost(url);
+	std::string header = createGETHeader(removeHost(url, host), host);
+
+	return fetch(host, header, url, sink, policy, report, pool);
+}
+
+bool DownloadHelper::fetch(const std::string& host, const std::string& request, const std::string& description, DataSink& sink, const DownloadPolicy& policy, DownloadReport* report, ConnectionPool* pool, unsigned int* status, HttpValidator* validator)
+{
+	std::string reason;
+	unsigned int attempt = 1;
+	for (; attempt<=policy.maxAttempts; ++attempt)
+	{
+		if (attempt > 1)
+		{
+			waitBeforeRetry(policy, attempt-1);
+			if (!sink.reset())
+			{
+				reason = "failed to reset content";
+				break;
+			}
+		}
+
+		try
+		{
+			ConnectionPtr connection;
+			if (pool)
+				connection = pool->acquire(host, policy);
+			else
+			{
+				connection = ConnectionPtr(new Connection(host, policy));
+				connection->connect();
+			}
+
+			connection->write(request);
+			connection->readHeader();
+			connection->readContent(sink);
+
+			if (status)
+				*status = connection->getStatus();
+			if (validator)
+				*validator = connection->getValidator();
+			if (pool)
+				pool->release(connection);
+
+			if (report)
+				report->addSuccess(attempt);
+			return true;
+		}
+		catch (HttpError& e)
+		{
+			reason = e.what();
+			if (!e.isTransient())
+				break;
+		}
+		catch (std::exception& e)
+		{
+			reason = e.what();
+		}
+	}
+
+	if (report)
+		report->addFailure(description, reason, std::min(attempt, policy.maxAttempts));
+	return false;
+}
+
+bool DownloadHelper::fetchFile(const std::string& url, const std::string& filepath, const DownloadPolicy& policy, DownloadReport* report, ConnectionPool* pool, DownloadCache* cache)
+{
+	std::string host = extractHost(url);
+	std::string request = removeHost(url, host);
+
+	unsigned int status = 0;
+	HttpValidator validator;
+	if (cache && cache->getValidator(url, validator))
+	{
+		//cached entry is reused only if the remote file hasn't changed
+		bool succeeded = fetchFile(host, createGETHeader(request, host, validator), url, filepath, policy, report, pool, &status, &validator);
+		if (!succeeded)
+			return false;
+		if (status == Connection::notModified && cache->get(url, filepath))
+			return true;
+		if (status != Connection::notModified)
+		{
+			cache->put(url, filepath, validator);
+			return true;
+		}
+		//entry removed since revalidation: full download
+	}
+
+	bool succeeded = fetchFile(host, createGETHeader(request, host), url, filepath, policy, report, pool, &status, &validator);
+	if (succeeded && cache)
+		cache->put(url, filepath, validator);
+
+	return succeeded;
+}
+
+bool DownloadHelper::fetchFile(const std::string& host, const std::string& request, const std::string& description, const std::string& filepath, const DownloadPolicy& policy, DownloadReport* report, ConnectionPool* pool, unsigned int* status, HttpValidator* validator)
+{
+	bool succeeded = false;
+	{
+		FileSink sink(filepath);
+		if (!sink.isOpen())
+		{
+			if (report)
+				report->addFailure(description, "failed to open " + filepath, 0);
+			return false;
+		}
+		succeeded = fetch(host, request, description, sink, policy, report, pool, status, validator);
+	}
 
-	delete[] buffer;
+	//don't leave a partial file: it would be considered as downloaded by the next run
+	if (!succeeded)
+		std::remove(filepath.c_str());
 
+	return succeeded;
+}
+
+bool DownloadHelper::fetchBuffer(const std::string& url, std::vector<char>& buffer, const DownloadPolicy& policy, DownloadReport* report, ConnectionPool* pool, DownloadCache* cache)
+{
+	std::string host = extractHost(url);
+	std::string request = removeHost(url, host);
+
+	buffer.clear();
+	MemorySink sink(buffer);
+
+	unsigned int status = 0;
+	HttpValidator validator;
+	if (cache && cache->getValidator(url, validator))
+	{
+		//cached entry is reused only if the remote file hasn't changed
+		bool succeeded = fetch(host, createGETHeader(request, host, validator), url, sink, policy, report, pool, &status, &validator);
+		if (!succeeded)
+			return false;
+		if (status == Connection::notModified && cache->get(url, buffer))
+			return true;
+		if (status != Connection::notModified)
+		{
+			cache->put(url, buffer, validator);
+			return true;
+		}
+		//entry removed since revalidation: full download
+		buffer.clear();
+	}
+
+	bool succeeded = fetch(host, createGETHeader(request, host), url, sink, policy, report, pool, &status, &validator);
+	if (succeeded && cache)
+		cache->put(url, buffer, validator);
+
+	return succeeded;
+}
+
+void DownloadHelper::waitBeforeRetry(const DownloadPolicy& policy, unsigned int attempt)
+{
+	boost::this_thread::sleep(boost::posix_time::milliseconds(policy.getBackoff(attempt)));
+}
+
+FileSink::FileSink(const std::string& filepath)
+{
+	mFilePath = filepath;
+
+	//never write through an existing file: it may be a hard-link to a DownloadCache entry
+	std::remove(filepath.c_str());
+	mOutput.open(filepath.c_str(), std::ios::binary);
+}
+
+FileSink::~FileSink()
+{
+	close();
+}
+
+bool FileSink::isOpen() const
+{
+	return mOutput.is_open();
+}
+
+void FileSink::close()
+{
+	if (mOutput.is_open())
+		mOutput.close();
+}
+
+bool FileSink::write(const char* data, std::size_t size)
+{
+	mOutput.write(data, size);
+	return mOutput.good();
+}
+
+bool FileSink::reset()
+{
+	close();
+	mOutput.clear();
+	mOutput.open(mFilePath.c_str(), std::ios::binary | std::ios::trunc);
+
+	return mOutput.is_open();
+}
+
+MemorySink::MemorySink(std::vector<char>& buffer)
+: mBuffer(buffer)
+{}
+
+bool MemorySink::write(const char* data, std::size_t size)
+{
+	mBuffer.insert(mBuffer.end(), data, data + size);
+	return true;
+}
+
+bool MemorySink::reset()
+{
+	mBuffer.clear();
 	return true;
 }
\ No newline at end of file
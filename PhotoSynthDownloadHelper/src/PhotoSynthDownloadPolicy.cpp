@@ -0,0 +1,160 @@
+/*
+	Copyright (c) 2010 ASTRE Henri (http://www.visual-experiments.com)
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+	THE SOFTWARE.
+*/
+
+#include "PhotoSynthDownloadPolicy.h"
+
+#include <fstream>
+#include <cstdlib>
+#include <ctime>
+#include <algorithm>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/thread/tss.hpp>
+
+using namespace PhotoSynth;
+
+namespace
+{
+	//rand() state is per thread and never seeded on the MSVC CRT: every download thread would draw the same jitter
+	boost::thread_specific_ptr<boost::mt19937> jitterGenerator;
+	boost::mutex jitterMutex;
+	unsigned int nbJitterGenerator = 0;
+
+	boost::mt19937& getJitterGenerator()
+	{
+		if (!jitterGenerator.get())
+		{
+			//time + creation order: distinct seeds for threads created within the same second
+			boost::mutex::scoped_lock lock(jitterMutex);
+			unsigned int seed = (unsigned int) time(NULL) + 2654435761u * ++nbJitterGenerator;
+			jitterGenerator.reset(new boost::mt19937(seed));
+		}
+		return *jitterGenerator;
+	}
+}
+
+DownloadPolicy::DownloadPolicy()
+{
+	connectTimeout = 10000;
+	readTimeout    = 30000;
+	maxAttempts    = 5;
+	initialBackoff = 500;
+	maxBackoff     = 16000;
+}
+
+bool DownloadPolicy::parseArgument(const std::string& argument)
+{
+	std::string::size_type separator = argument.find('=');
+	if (separator == std::string::npos)
+		return false;
+
+	std::string name = argument.substr(0, separator);
+	unsigned int value = (unsigned int) atoi(argument.substr(separator+1).c_str());
+
+	if (name == "timeout")
+	{
+		connectTimeout = value;
+		readTimeout    = value;
+	}
+	else if (name == "attempts")
+		maxAttempts = std::max(value, 1u);
+	else if (name == "backoff")
+		initialBackoff = value;
+	else
+		return false;
+
+	return true;
+}
+
+unsigned int DownloadPolicy::getBackoff(unsigned int attempt) const
+{
+	//initialBackoff * 2^(attempt-1) capped by maxBackoff
+	unsigned int backoff = initialBackoff;
+	for (unsigned int i=1; i<attempt && backoff < maxBackoff; ++i)
+		backoff *= 2;
+	backoff = std::min(backoff, maxBackoff);
+
+	//jitter: random delay in [backoff/2, backoff] so that failed workers don't retry all together
+	return backoff/2 + (unsigned int)(getJitterGenerator()() % (backoff/2 + 1));
+}
+
+DownloadFailure::DownloadFailure(const std::string& url, const std::string& reason, unsigned int nbAttempt)
+{
+	this->url       = url;
+	this->reason    = reason;
+	this->nbAttempt = nbAttempt;
+}
+
+DownloadReport::DownloadReport()
+{
+	mNbSuccess = 0;
+	mNbRetry   = 0;
+}
+
+void DownloadReport::addSuccess(unsigned int nbAttempt)
+{
+	boost::mutex::scoped_lock lock(mMutex);
+	mNbSuccess++;
+	if (nbAttempt > 0)
+		mNbRetry += nbAttempt-1;
+}
+
+void DownloadReport::addFailure(const std::string& url, const std::string& reason, unsigned int nbAttempt)
+{
+	boost::mutex::scoped_lock lock(mMutex);
+	mFailures.push_back(DownloadFailure(url, reason, nbAttempt));
+	if (nbAttempt > 0) //0: failed before any attempt (output file can't be opened...)
+		mNbRetry += nbAttempt-1;
+}
+
+unsigned int DownloadReport::getNbSuccess() const
+{
+	boost::mutex::scoped_lock lock(mMutex);
+	return mNbSuccess;
+}
+
+unsigned int DownloadReport::getNbFailure() const
+{
+	boost::mutex::scoped_lock lock(mMutex);
+	return mFailures.size();
+}
+
+void DownloadReport::print(std::ostream& output) const
+{
+	boost::mutex::scoped_lock lock(mMutex);
+	output << "[" << mNbSuccess << " files downloaded, " << mFailures.size() << " failed, " << mNbRetry << " retries]" << std::endl;
+	for (unsigned int i=0; i<mFailures.size(); ++i)
+		output << "Failed: " << mFailures[i].url << " (" << mFailures[i].reason << ", " << mFailures[i].nbAttempt << " attempts)" << std::endl;
+}
+
+bool DownloadReport::save(const std::string& filepath) const
+{
+	std::ofstream output(filepath.c_str());
+	if (!output.is_open())
+		return false;
+
+	boost::mutex::scoped_lock lock(mMutex);
+	for (unsigned int i=0; i<mFailures.size(); ++i)
+		output << mFailures[i].url << " " << mFailures[i].nbAttempt << " " << mFailures[i].reason << std::endl;
+	output.close();
+
+	return true;
+}
@@ -0,0 +1,83 @@
+/*
+	Copyright (c) 2010 ASTRE Henri (http://www.visual-experiments.com)
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+	THE SOFTWARE.
+*/
+
+#pragma once
+
+#include "PhotoSynthDownloader.h"
+#include <boost/thread/mutex.hpp>
+
+namespace PhotoSynth
+{
+	struct BatchJob
+	{
+		enum Status
+		{
+			PENDING,
+			RUNNING,
+			DONE,
+			FAILED
+		};
+
+		BatchJob();
+
+		std::string  guid;
+		Status       status;
+		unsigned int nbSuccess;
+		unsigned int nbFailure;
+		double       duration; //seconds
+	};
+
+	//Download a list of synth (one guid per line) in a single process:
+	//several synths are downloaded at the same time, sharing the keep-alive connections
+	//and the thumb worker threads. Progress is stored in batch_state.txt in the output folder
+	//so that an interrupted batch only downloads the synths that are not done yet.
+	class BatchDownloader
+	{
+		public:
+			BatchDownloader(const DownloadPolicy& policy = DownloadPolicy(), unsigned int nbJob = 4, unsigned int nbThumbThread = 8, DownloadCache* cache = NULL, bool asciiPly = false, const std::vector<std::string>& exporterNames = std::vector<std::string>());
+
+			bool download(const std::string& guidListFilePath, const std::string& outputFolder, bool downloadThumb);
+
+			static const std::string stateFilename;
+
+		protected:
+			bool loadGuidList(const std::string& guidListFilePath);
+			void loadState(const std::string& stateFilePath);
+			void saveState(const std::string& stateFilePath);
+			void downloadSynth(unsigned int index);
+			void printSummary(std::ostream& output);
+
+			static std::string toString(BatchJob::Status status);
+
+			DownloadPolicy           mPolicy;
+			unsigned int             mNbJob;
+			ConnectionPool           mConnectionPool;
+			boost::threadpool::pool  mThumbPool;
+			DownloadCache*           mCache;
+			std::vector<BatchJob>    mJobs;
+			boost::mutex             mMutex;
+			std::string              mOutputFolder;
+			bool                     mDownloadThumb;
+			bool                     mAsciiPly;
+			std::vector<std::string> mExporterNames;
+	};
+}
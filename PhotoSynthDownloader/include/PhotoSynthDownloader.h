@@ -24,7 +24,9 @@
 
 #include "PhotoSynthParser.h"
 #include <PhotoSynthDownloadHelper.h>
-#include <boost/asio.hpp>
+#include <boost/threadpool.hpp>
+#include <boost/thread/mutex.hpp>
+#include <iostream>
 
 namespace PhotoSynth
 {
@@ -46,22 +48,62 @@ namespace PhotoSynth
 	class Downloader
 	{
 		public:
-			Downloader(boost::asio::io_service* service);
+			//pool, threadPool and cache are optional, they can be shared by several Downloader (batch mode)
+			//asciiPly: write coord_system_*.ply as ascii instead of binary little-endian
+			//exporterNames: names of the exporters to run once the synth is parsed, empty: all exporters
+			Downloader(const DownloadPolicy& policy = DownloadPolicy(), ConnectionPool* pool = NULL, boost::threadpool::pool* threadPool = NULL, DownloadCache* cache = NULL, bool asciiPly = false, const std::vector<std::string>& exporterNames = std::vector<std::string>());
+
+			//return false if any file failed to download (listed in download_failures.txt and getReport)
 			bool download(const std::string& guid, const std::string& outputFolder, bool downloadThumb);
 
+			const DownloadReport& getReport() const;
+
+			//messages are written to output (default: std::cout), batch mode gives one buffer per synth
+			//and prints the shared cache stats once for the whole batch (printCacheStats = false)
+			void setOutput(std::ostream* output, bool printCacheStats);
+
+			//command line option: export=<name>,<name>,... (argument must start with "export=")
+			//return false if the list is empty or contains an unknown exporter
+			static bool parseExportArgument(const std::string& argument, std::vector<std::string>& exporterNames);
+
+			//output files generated from a parsed synth: exporters only read the parser so they run at the same time
+			struct Exporter
+			{
+				typedef void (Downloader::*Function)(const std::string& outputFolder, const Parser* parser);
+
+				const char* name;
+				const char* description;
+				Function    function;
+			};
+			static const Exporter exporters[];
+			static const unsigned int nbExporter;
+
 		protected:
 
 			bool downloadSoap(const std::string& soapFilePath, const std::string& guid);
 			bool downloadJson(const std::string& jsonFilePath, const std::string& jsonUrl);
 			void downloadAllBinFiles(const std::string& outputFolder, Parser* parser);
-			void downloadAllThumbFiles(const std::string& outputFolder, const JsonInfo& info);
-			void downloadThumb(const std::string& outputFolder, const JsonInfo& info, unsigned int index);
-			void savePly(const std::string& outputFolder, Parser* parser);
+			void startAllThumbFiles(const std::string& outputFolder, const JsonInfo& info, boost::threadpool::pool& threadPool, std::vector<boost::threadpool::future<bool> >& tasks);
+			void waitAllThumbFiles(std::vector<boost::threadpool::future<bool> >& tasks);
+			bool downloadThumb(const std::string& outputFolder, const JsonInfo& info, unsigned int index);
+			void exportAll(const std::string& outputFolder, const Parser& parser);
+			void runExporter(const Exporter* exporter, const std::string& outputFolder, const Parser* parser);
+			static unsigned int getNbVertex(const std::string& outputFolder, const Parser* parser, unsigned int coordSystemIndex);
+			void savePly(const std::string& outputFolder, const Parser* parser);
 			void saveCamerasParameters(const std::string& outputFolder, Parser* parser);
-			void save3DSMaxScript(const std::string& outputFolder, Parser* parser);
-			void saveXSIScript(const std::string& outputFolder, Parser* parser);
-			void savePlyForManualClustering(const std::string& outputFolder, Parser* parser);
+			void save3DSMaxScript(const std::string& outputFolder, const Parser* parser);
+			void saveXSIScript(const std::string& outputFolder, const Parser* parser);
+			void savePlyForManualClustering(const std::string& outputFolder, const Parser* parser);
 
-			boost::asio::io_service* mService;
+			DownloadPolicy mPolicy;
+			DownloadReport mReport;
+			ConnectionPool* mPool;
+			boost::threadpool::pool* mThreadPool;
+			DownloadCache* mCache;
+			bool mAsciiPly;
+			std::vector<const Exporter*> mExporters;
+			std::ostream* mOutput;
+			boost::mutex mOutputMutex; //exporters run at the same time
+			bool mPrintCacheStats;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,232 @@
+/*
+	Copyright (c) 2010 ASTRE Henri (http://www.visual-experiments.com)
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+	THE SOFTWARE.
+*/
+
+#include "PhotoSynthBatchDownloader.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <boost/filesystem/operations.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+using namespace PhotoSynth;
+namespace bf = boost::filesystem;
+
+const std::string BatchDownloader::stateFilename = "batch_state.txt";
+
+BatchJob::BatchJob()
+{
+	status    = PENDING;
+	nbSuccess = 0;
+	nbFailure = 0;
+	duration  = 0;
+}
+
+BatchDownloader::BatchDownloader(const DownloadPolicy& policy, unsigned int nbJob, unsigned int nbThumbThread, DownloadCache* cache, bool asciiPly, const std::vector<std::string>& exporterNames)
+: mThumbPool(nbThumbThread)
+{
+	mPolicy        = policy;
+	mCache         = cache;
+	mNbJob         = std::max(1u, nbJob);
+	mDownloadThumb = false;
+	mAsciiPly      = asciiPly;
+	mExporterNames = exporterNames;
+}
+
+bool BatchDownloader::download(const std::string& guidListFilePath, const std::string& outputFolder, bool downloadThumb)
+{
+	if (!loadGuidList(guidListFilePath))
+	{
+		std::cout << "Error while reading guid list: " << guidListFilePath << std::endl;
+		return false;
+	}
+
+	if (!bf::exists(outputFolder))
+		bf::create_directory(outputFolder);
+
+	mOutputFolder  = outputFolder;
+	mDownloadThumb = downloadThumb;
+
+	std::string stateFilePath = Parser::createFilePath(outputFolder, stateFilename);
+	loadState(stateFilePath);
+
+	{
+		boost::threadpool::pool jobPool(mNbJob);
+		for (unsigned int i=0; i<mJobs.size(); ++i)
+		{
+			if (mJobs[i].status != BatchJob::DONE)
+				jobPool.schedule(boost::bind(&BatchDownloader::downloadSynth, this, i));
+		}
+	} //wait for all jobs
+
+	printSummary(std::cout);
+
+	for (unsigned int i=0; i<mJobs.size(); ++i)
+	{
+		if (mJobs[i].status != BatchJob::DONE)
+			return false;
+	}
+	return true;
+}
+
+bool BatchDownloader::loadGuidList(const std::string& guidListFilePath)
+{
+	std::ifstream input(guidListFilePath.c_str());
+	if (!input.is_open())
+		return false;
+
+	mJobs.clear();
+	std::string line;
+	while (std::getline(input, line))
+	{
+		std::stringstream stream(line);
+		std::string guid;
+		stream >> guid;
+		if (guid.empty() || guid[0] == '#')
+			continue;
+
+		BatchJob job;
+		job.guid = guid;
+		mJobs.push_back(job);
+	}
+
+	return true;
+}
+
+void BatchDownloader::loadState(const std::string& stateFilePath)
+{
+	std::ifstream input(stateFilePath.c_str());
+	if (!input.is_open())
+		return;
+
+	std::string guid;
+	std::string status;
+	while (input >> guid >> status)
+	{
+		if (status != toString(BatchJob::DONE))
+			continue;
+
+		for (unsigned int i=0; i<mJobs.size(); ++i)
+		{
+			if (mJobs[i].guid == guid)
+				mJobs[i].status = BatchJob::DONE;
+		}
+	}
+}
+
+void BatchDownloader::saveState(const std::string& stateFilePath)
+{
+	//called with mMutex locked
+	std::string tmpFilePath = stateFilePath + ".tmp";
+	{
+		std::ofstream output(tmpFilePath.c_str());
+		for (unsigned int i=0; i<mJobs.size(); ++i)
+			output << mJobs[i].guid << " " << toString(mJobs[i].status) << std::endl;
+	}
+
+	//replace the previous state only once the new one is complete
+	if (bf::exists(stateFilePath))
+		bf::remove(stateFilePath);
+	bf::rename(tmpFilePath, stateFilePath);
+}
+
+void BatchDownloader::downloadSynth(unsigned int index)
+{
+	BatchJob& job = mJobs[index];
+	{
+		boost::mutex::scoped_lock lock(mMutex);
+		job.status = BatchJob::RUNNING;
+		std::cout << "[" << index+1 << "/" << mJobs.size() << "] " << job.guid << std::endl;
+	}
+
+	boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+
+	//jobs run at the same time: messages are buffered and printed once the job is over, one guid prefixed line each
+	std::stringstream output;
+	bool success = false;
+	Downloader downloader(mPolicy, &mConnectionPool, &mThumbPool, mCache, mAsciiPly, mExporterNames);
+	downloader.setOutput(&output, false);
+	try
+	{
+		success = downloader.download(job.guid, Parser::createFilePath(mOutputFolder, job.guid), mDownloadThumb);
+	}
+	catch (std::exception& e)
+	{
+		output << e.what() << std::endl;
+	}
+
+	boost::posix_time::time_duration elapsed = boost::posix_time::microsec_clock::universal_time() - start;
+
+	boost::mutex::scoped_lock lock(mMutex);
+	std::string line;
+	while (std::getline(output, line))
+		std::cout << job.guid << ": " << line << std::endl;
+
+	job.nbSuccess = downloader.getReport().getNbSuccess();
+	job.nbFailure = downloader.getReport().getNbFailure();
+	job.duration  = elapsed.total_milliseconds() / 1000.0;
+	job.status    = (success && job.nbFailure == 0) ? BatchJob::DONE : BatchJob::FAILED;
+	saveState(Parser::createFilePath(mOutputFolder, stateFilename));
+}
+
+void BatchDownloader::printSummary(std::ostream& output)
+{
+	unsigned int nbDone    = 0;
+	unsigned int nbFailed  = 0;
+	unsigned int nbSkipped = 0;
+
+	output << std::endl << "Batch summary:" << std::endl;
+	for (unsigned int i=0; i<mJobs.size(); ++i)
+	{
+		const BatchJob& job = mJobs[i];
+		if (job.status == BatchJob::DONE && job.duration == 0 && job.nbSuccess == 0 && job.nbFailure == 0)
+		{
+			output << job.guid << " done (skipped: already downloaded)" << std::endl;
+			nbSkipped++;
+			continue;
+		}
+
+		output << job.guid << " " << toString(job.status);
+		output << " (" << job.nbSuccess << " files, " << job.nbFailure << " failures, ";
+		output << std::fixed << std::setprecision(1) << job.duration << "s)" << std::endl;
+
+		if (job.status == BatchJob::DONE)
+			nbDone++;
+		else
+			nbFailed++;
+	}
+	output << nbDone << " done, " << nbFailed << " failed, " << nbSkipped << " skipped" << std::endl;
+	if (mCache)
+		mCache->print(output);
+}
+
+std::string BatchDownloader::toString(BatchJob::Status status)
+{
+	switch (status)
+	{
+		case BatchJob::PENDING: return "pending";
+		case BatchJob::RUNNING: return "running";
+		case BatchJob::DONE:    return "done";
+		default:                return "failed";
+	}
+}
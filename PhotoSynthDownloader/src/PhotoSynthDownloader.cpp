@@ -21,31 +21,97 @@
 */
 
 #include "PhotoSynthDownloader.h"
+#include "PhotoSynthPlyWriter.h"
+#include <PhotoSynthTextWriter.h>
+#include <PhotoSynthBinFileReader.h>
 
-#include <boost/threadpool.hpp>
 #include <boost/filesystem/operations.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/bind.hpp>
+#include <algorithm>
 #include <OgreStringVector.h>
 #include <OgreMatrix3.h>
 
 using namespace PhotoSynth;
 namespace bf = boost::filesystem;
 
-using boost::asio::ip::tcp;
+const Downloader::Exporter Downloader::exporters[] =
+{
+	{ "ply",        "coord_system_<i>.ply and coord_system_<i>_with_cameras.ply", &Downloader::savePly },
+	{ "max",        "cameras_max.ms (3DS Max script)",                            &Downloader::save3DSMaxScript },
+	{ "xsi",        "cameras_xsi.vbs (XSI script)",                               &Downloader::saveXSIScript },
+	{ "clustering", "cameras_clustering.ply (manual clustering)",                 &Downloader::savePlyForManualClustering }
+};
+const unsigned int Downloader::nbExporter = sizeof(Downloader::exporters) / sizeof(Downloader::Exporter);
+
+Downloader::Downloader(const DownloadPolicy& policy, ConnectionPool* pool, boost::threadpool::pool* threadPool, DownloadCache* cache, bool asciiPly, const std::vector<std::string>& exporterNames)
+{
+	mPolicy          = policy;
+	mPool            = pool;
+	mThreadPool      = threadPool;
+	mCache           = cache;
+	mAsciiPly        = asciiPly;
+	mOutput          = &std::cout;
+	mPrintCacheStats = true;
+
+	for (unsigned int i=0; i<nbExporter; ++i)
+	{
+		if (exporterNames.empty() || std::find(exporterNames.begin(), exporterNames.end(), exporters[i].name) != exporterNames.end())
+			mExporters.push_back(&exporters[i]);
+	}
+}
+
+bool Downloader::parseExportArgument(const std::string& argument, std::vector<std::string>& exporterNames)
+{
+	//export=ply,max,xsi,clustering
+	if (argument.find("export=") != 0)
+		return false;
+
+	//an empty list means all exporters: a typo must not silently run them all
+	Ogre::StringVector names = Ogre::StringUtil::split(argument.substr(7), ",");
+	if (names.empty())
+	{
+		std::cout << "No exporter given in " << argument << std::endl;
+		return false;
+	}
+
+	for (unsigned int i=0; i<names.size(); ++i)
+	{
+		bool found = false;
+		for (unsigned int j=0; j<nbExporter && !found; ++j)
+			found = (names[i] == exporters[j].name);
+
+		if (!found)
+		{
+			std::cout << "Unknown exporter: " << names[i] << std::endl;
+			return false;
+		}
+		exporterNames.push_back(names[i]);
+	}
 
-Downloader::Downloader(boost::asio::io_service* service)
+	return true;
+}
+
+const DownloadReport& Downloader::getReport() const
 {
-	mService = service;
+	return mReport;
+}
+
+void Downloader::setOutput(std::ostream* output, bool printCacheStats)
+{
+	mOutput          = output;
+	mPrintCacheStats = printCacheStats;
 }
 
 bool Downloader::download(const std::string& guid, const std::string& outputFolder, bool downloadThumb)
 {	
-	DownloadHelper::saveAsciiFile(Parser::createFilePath(outputFolder, Parser::guidFilename), guid);
-
 	Parser parser;
 
 	if (!bf::exists(outputFolder))
 		bf::create_directory(outputFolder);
 
+	DownloadHelper::saveAsciiFile(Parser::createFilePath(outputFolder, Parser::guidFilename), guid);
+
 	std::stringstream path;
 	path << outputFolder << "/bin";
 
@@ -75,7 +141,7 @@ bool Downloader::download(const std::string& guid, const std::string& outputFold
 	{
 		if (!downloadSoap(soapFilePath, guid))
 		{
-			std::cout << "Error while downloading Soap request" << std::endl;
+			*mOutput << "Error while downloading Soap request" << std::endl;
 			return false;
 		}
 	}
@@ -87,199 +153,218 @@ bool Downloader::download(const std::string& guid, const std::string& outputFold
 	{		
 		if (!downloadJson(jsonFilePath, parser.getSoapInfo().jsonUrl))
 		{
-			std::cout << "Error while downloading JSON file" << std::endl;
+			*mOutput << "Error while downloading JSON file" << std::endl;
 			return false;
 		}
 	}
 
 	parser.parseJson(jsonFilePath, guid);
-	saveCamerasParameters(outputFolder, &parser);
-
-	downloadAllBinFiles(outputFolder, &parser);
 
-	parser.parseBinFiles(outputFolder);
-
-	//stats
-	std::cout << "PhotoSynth composed of " << parser.getJsonInfo().thumbs.size() << " pictures and " << parser.getNbCoordSystem() << " CoordSystems:" << std::endl;
-	for (unsigned int i=0; i<parser.getNbCoordSystem(); ++i)
-		std::cout << "[" << i<< "]: " << parser.getNbCamera(i) << " cameras, " << parser.getNbVertex(i) << " points" <<std::endl;
+	//thumb urls and bin files are both known once the json is parsed:
+	//thumbs are downloaded in the background while bin files are downloaded, parsed and exported
+	boost::threadpool::pool localThreadPool(mThreadPool ? 0 : 8);
+	boost::threadpool::pool& threadPool = mThreadPool ? *mThreadPool : localThreadPool;
 
+	std::vector<boost::threadpool::future<bool> > thumbTasks;
 	if (downloadThumb)
-		downloadAllThumbFiles(outputFolder, parser.getJsonInfo());
-
-	savePly(outputFolder, &parser);
-	save3DSMaxScript(outputFolder, &parser);
-	saveXSIScript(outputFolder, &parser);
-	savePlyForManualClustering(outputFolder, &parser);
+		startAllThumbFiles(outputFolder, parser.getJsonInfo(), threadPool, thumbTasks);
 
-	return true;
-}
-
-bool Downloader::downloadSoap(const std::string& soapFilePath, const std::string& guid)
-{
 	try
 	{
-		SocketPtr sock = DownloadHelper::connect(mService, "www.photosynth.net");
-
-		//prepare header + content
-		std::stringstream content;
-		content << "<?xml version=\"1.0\" encoding=\"utf-8\"?>"<<std::endl;
-		content << "<soap12:Envelope xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\" xmlns:xsd=\"http://www.w3.org/2001/XMLSchema\" xmlns:soap12=\"http://www.w3.org/2003/05/soap-envelope\">"<<std::endl;
-		content << "	<soap12:Body>"<<std::endl;
-		content << "		<GetCollectionData xmlns=\"http://labs.live.com/\">"<<std::endl;
-		content << "		<collectionId>"<<guid<<"</collectionId>"<<std::endl;
-		content << "		<incrementEmbedCount>false</incrementEmbedCount>"<<std::endl;
-		content << "		</GetCollectionData>"<<std::endl;
-		content << "	</soap12:Body>"<<std::endl;
-		content << "</soap12:Envelope>"<<std::endl;
-
-		std::stringstream header;
-		header << "POST /photosynthws/PhotosynthService.asmx HTTP/1.1"<<std::endl;
-		header << "Host: photosynth.net"<<std::endl;
-		header << "Content-Type: application/soap+xml; charset=utf-8"<<std::endl;
-		header << "Content-Length: "<<content.str().size()<<std::endl;
-		header << ""<<std::endl;
-
-		//send header + content
-		boost::system::error_code error;
-		boost::asio::write(*sock, boost::asio::buffer(header.str().c_str()), boost::asio::transfer_all(), error);
-		boost::asio::write(*sock, boost::asio::buffer(content.str().c_str()), boost::asio::transfer_all(), error);
-
-		sock->shutdown(tcp::socket::shutdown_send);
-
-		//read the response
-		boost::asio::streambuf response;
-		while (boost::asio::read(*sock, response, boost::asio::transfer_at_least(1), error));
-
-		sock->close();
-
-		std::istream response_stream(&response);
-		std::string line;
-
-		//skip header from response
-		while (std::getline(response_stream, line) && line != "\r");		
-
-		//put soap response into xml
-		std::stringstream xml;
-		while (std::getline(response_stream, line))
-			xml << line << std::endl;
-
-		//save soap response
-		if (!DownloadHelper::saveAsciiFile(soapFilePath, xml.str()))
-			return false;		
-	}
-	catch (std::exception& e)
-	{		
-		std::cout << e.what() << std::endl;
-		return false;
-	}
-	return true;
-}
+		saveCamerasParameters(outputFolder, &parser);
 
-bool Downloader::downloadJson(const std::string& jsonFilePath, const std::string& jsonUrl)
-{
-	try
-	{
-		std::string host = DownloadHelper::extractHost(jsonUrl);
-		SocketPtr sock = DownloadHelper::connect(mService, host);
+		downloadAllBinFiles(outputFolder, &parser);
 
-		std::string header = DownloadHelper::createGETHeader(DownloadHelper::removeHost(jsonUrl, host), host);
+		//bin files are not parsed: exporters stream them (point clouds of huge synths don't fit in memory)
 
-		//send GET request
-		boost::system::error_code error;
-		boost::asio::write(*sock, boost::asio::buffer(header.c_str()), boost::asio::transfer_all(), error);
+		//stats
+		*mOutput << "PhotoSynth composed of " << parser.getJsonInfo().thumbs.size() << " pictures and " << parser.getNbCoordSystem() << " CoordSystems:" << std::endl;
+		for (unsigned int i=0; i<parser.getNbCoordSystem(); ++i)
+			*mOutput << "[" << i<< "]: " << parser.getNbCamera(i) << " cameras, " << getNbVertex(outputFolder, &parser, i) << " points" <<std::endl;
 
-		//read the response (header + content)
-		boost::asio::streambuf response;
-		while (boost::asio::read(*sock, response, boost::asio::transfer_at_least(1), error));
+		exportAll(outputFolder, parser);
+	}
+	catch (...)
+	{
+		//thumb tasks are using parser's JsonInfo
+		waitAllThumbFiles(thumbTasks);
+		throw;
+	}
 
-		sock->close();
+	waitAllThumbFiles(thumbTasks);
 
-		//skip header from response
-		std::istream response_stream(&response);
-		std::string line;
-		while (std::getline(response_stream, line) && line != "\r");
+	mReport.print(*mOutput);
+	if (mCache && mPrintCacheStats)
+		mCache->print(*mOutput);
+	if (mReport.getNbFailure() > 0)
+		mReport.save(Parser::createFilePath(outputFolder, "download_failures.txt"));
 
-		//put json into jsonText
-		std::stringstream jsonText;
-		while (std::getline(response_stream, line))
-			jsonText << line << std::endl;
+	return mReport.getNbFailure() == 0;
+}
 
-		//save json
-		if (!DownloadHelper::saveAsciiFile(jsonFilePath, jsonText.str()))
-			return false;
-	}
-	catch (std::exception& e)
-	{		
-		std::cout << e.what() << std::endl;
-		return false;
-	}
-	return true;
+bool Downloader::downloadSoap(const std::string& soapFilePath, const std::string& guid)
+{
+	//prepare header + content
+	std::stringstream content;
+	content << "<?xml version=\"1.0\" encoding=\"utf-8\"?>"<<std::endl;
+	content << "<soap12:Envelope xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\" xmlns:xsd=\"http://www.w3.org/2001/XMLSchema\" xmlns:soap12=\"http://www.w3.org/2003/05/soap-envelope\">"<<std::endl;
+	content << "	<soap12:Body>"<<std::endl;
+	content << "		<GetCollectionData xmlns=\"http://labs.live.com/\">"<<std::endl;
+	content << "		<collectionId>"<<guid<<"</collectionId>"<<std::endl;
+	content << "		<incrementEmbedCount>false</incrementEmbedCount>"<<std::endl;
+	content << "		</GetCollectionData>"<<std::endl;
+	content << "	</soap12:Body>"<<std::endl;
+	content << "</soap12:Envelope>"<<std::endl;
+
+	std::stringstream header;
+	header << "POST /photosynthws/PhotosynthService.asmx HTTP/1.1"<<std::endl;
+	header << "Host: photosynth.net"<<std::endl;
+	header << "Content-Type: application/soap+xml; charset=utf-8"<<std::endl;
+	header << "Content-Length: "<<content.str().size()<<std::endl;
+	header << ""<<std::endl;
+
+	//send header + content, save soap response
+	return DownloadHelper::fetchFile("www.photosynth.net", header.str() + content.str(), "soap request " + guid, soapFilePath, mPolicy, &mReport, mPool);
+}
+
+bool Downloader::downloadJson(const std::string& jsonFilePath, const std::string& jsonUrl)
+{
+	return DownloadHelper::fetchFile(jsonUrl, jsonFilePath, mPolicy, &mReport, mPool, mCache);
 }
 
 void Downloader::downloadAllBinFiles(const std::string& outputFolder, Parser* parser)
 {
 	std::string host = DownloadHelper::extractHost(parser->getSoapInfo().collectionRoot);
 
-	SocketPtr sock = DownloadHelper::connect(mService, host);
-	boost::asio::socket_base::keep_alive keepAlive(true);
-	sock->set_option(keepAlive);
-
-	std::stringstream headers;
 	std::vector<std::string> filenames;
-
-	int nbCoorSystem = parser->getNbCoordSystem();
+	std::vector<std::string> urls;
+	std::vector<HttpValidator> validators; //cached files are revalidated by conditional GET
 
 	for (unsigned int i=0; i<parser->getNbCoordSystem(); ++i)
 	{
-		int nbPointCloud = parser->getNbPointCloud(i);
 		for (unsigned int j=0; j<parser->getNbPointCloud(i); ++j)
 		{
 			std::stringstream filename;
 			filename << "bin/points_"<< i << "_" << j << ".bin";
-			if (!bf::exists(Parser::createFilePath(outputFolder, filename.str())))
+			std::string filepath = Parser::createFilePath(outputFolder, filename.str());
+			if (!bf::exists(filepath))
 			{
-				filenames.push_back(filename.str());
 				std::stringstream url;
 				url << parser->getSoapInfo().collectionRoot << filename.str().substr(4);
-				headers << DownloadHelper::createGETHeader(DownloadHelper::removeHost(url.str(), host), host);
+				HttpValidator validator;
+				if (mCache)
+					mCache->getValidator(url.str(), validator);
+
+				filenames.push_back(filename.str());
+				urls.push_back(url.str());
+				validators.push_back(validator);
 			}
 		}
 	}
 
-	if (filenames.size() > 0)
+	//all requests are pipelined on one (pooled) connection, a failed attempt resumes at the first missing file
+	//a permanent http error (4xx) only fails its file: the next ones are requested again on another connection
+	unsigned int nbDownloaded = 0;
+	unsigned int nbFailedAttempt = 0;
+	std::string reason;
+	while (nbDownloaded<filenames.size() && nbFailedAttempt<mPolicy.maxAttempts)
 	{
-		//send GET request
-		boost::system::error_code error;
-		boost::asio::write(*sock, boost::asio::buffer(headers.str().c_str()), boost::asio::transfer_all(), error);
+		if (nbFailedAttempt > 0)
+			DownloadHelper::waitBeforeRetry(mPolicy, nbFailedAttempt);
+		unsigned int attempt = nbFailedAttempt+1;
+
+		std::string filepath;
+		try
+		{
+			ConnectionPtr connection;
+			if (mPool)
+				connection = mPool->acquire(host, mPolicy);
+			else
+			{
+				connection = ConnectionPtr(new Connection(host, mPolicy));
+				connection->connect();
+			}
 
-		//read the response (header + content)
-		boost::asio::streambuf response;
-		while (boost::asio::read(*sock, response, boost::asio::transfer_at_least(1), error));
+			//send GET request
+			std::stringstream headers;
+			for (unsigned int i=nbDownloaded; i<filenames.size(); ++i)
+				headers << DownloadHelper::createGETHeader(DownloadHelper::removeHost(urls[i], host), host, validators[i]);
+			connection->write(headers.str());
+
+			//read each response (header + content) and stream its content to disk
+			for (; nbDownloaded<filenames.size(); ++nbDownloaded)
+			{
+				filepath = Parser::createFilePath(outputFolder, filenames[nbDownloaded]);
+				connection->readHeader();
+
+				{
+					FileSink sink(filepath);
+					connection->readContent(sink);
+				}
+				if (connection->getStatus() == Connection::notModified)
+				{
+					if (!mCache->get(urls[nbDownloaded], filepath))
+					{
+						//entry removed since revalidation: requested again without condition
+						validators[nbDownloaded] = HttpValidator();
+						throw std::runtime_error("cache entry removed for " + urls[nbDownloaded]);
+					}
+				}
+				else if (mCache)
+					mCache->put(urls[nbDownloaded], filepath, connection->getValidator());
+				mReport.addSuccess(attempt);
+			}
 
-		//read all response header and content
-		std::istream response_stream(&response);
-		for (unsigned int i=0; i<filenames.size(); ++i)
+			//every pipelined response has been read: the connection can be reused
+			if (mPool)
+				mPool->release(connection);
+		}
+		catch (HttpError& e)
+		{
+			if (e.isTransient())
+			{
+				reason = e.what();
+				++nbFailedAttempt;
+			}
+			else
+			{
+				mReport.addFailure(urls[nbDownloaded], e.what(), attempt);
+				++nbDownloaded;
+			}
+		}
+		catch (std::exception& e)
 		{
-			int length = DownloadHelper::getContentLength(response_stream);
-			DownloadHelper::saveBinFile(Parser::createFilePath(outputFolder, filenames[i]), response_stream, length);
+			reason = e.what();
+			std::remove(filepath.c_str()); //partial file
+			++nbFailedAttempt;
 		}
 	}
 
-	sock->close();
+	for (unsigned int i=nbDownloaded; i<filenames.size(); ++i)
+		mReport.addFailure(urls[i], reason, nbFailedAttempt);
 }
 
-void Downloader::downloadAllThumbFiles(const std::string& outputFolder, const JsonInfo& info)
+void Downloader::startAllThumbFiles(const std::string& outputFolder, const JsonInfo& info, boost::threadpool::pool& threadPool, std::vector<boost::threadpool::future<bool> >& tasks)
 {
-	std::cout << std::endl;
-	std::cout << "Downloading " << info.thumbs.size() << " thumbs" << std::endl;
+	*mOutput << std::endl;
+	*mOutput << "Downloading " << info.thumbs.size() << " thumbs" << std::endl;
 
-	boost::threadpool::pool tp(8);
 	for (unsigned int i=0; i<info.thumbs.size(); ++i)
-		tp.schedule(boost::bind(&Downloader::downloadThumb, this, outputFolder, info, i));
+	{
+		boost::function<bool ()> task = boost::bind(&Downloader::downloadThumb, this, outputFolder, boost::cref(info), i);
+		tasks.push_back(boost::threadpool::schedule(threadPool, task));
+	}
 }
 
-void Downloader::downloadThumb(const std::string& outputFolder, const JsonInfo& info, unsigned int index)
+void Downloader::waitAllThumbFiles(std::vector<boost::threadpool::future<bool> >& tasks)
+{
+	//the thread pool may be shared: only wait for the thumbs of this synth
+	for (unsigned int i=0; i<tasks.size(); ++i)
+		tasks[i].wait();
+	tasks.clear();
+}
+
+bool Downloader::downloadThumb(const std::string& outputFolder, const JsonInfo& info, unsigned int index)
 {
 	char buf[10];
 	sprintf(buf, "%08d", index);
@@ -288,117 +373,108 @@ void Downloader::downloadThumb(const std::string& outputFolder, const JsonInfo&
 	filename << "thumbs/" << buf << ".jpg";
 
 	std::string filepath = Parser::createFilePath(outputFolder, filename.str());
-	if (!bf::exists(filepath))
-	{
-		std::string host = DownloadHelper::extractHost(info.thumbs[index].url);
-		SocketPtr sock = DownloadHelper::connect(mService, host);
-
-		std::string header = DownloadHelper::createGETHeader(DownloadHelper::removeHost(info.thumbs[index].url, host), host);
+	if (bf::exists(filepath))
+		return true;
 
-		//send GET request
-		boost::system::error_code error;
-		boost::asio::write(*sock, boost::asio::buffer(header.c_str()), boost::asio::transfer_all(), error);
-
-		//read the response (header + content)
-		boost::asio::streambuf response;
-		while (boost::asio::read(*sock, response, boost::asio::transfer_at_least(1), error));
+	return DownloadHelper::fetchFile(info.thumbs[index].url, filepath, mPolicy, &mReport, mPool, mCache);
+}
 
-		std::istream response_stream(&response);
-		int length = DownloadHelper::getContentLength(response_stream);
+void Downloader::exportAll(const std::string& outputFolder, const Parser& parser)
+{
+	//exporters only read the parsed synth and write their own files: one thread per exporter
+	boost::thread_group threads;
+	for (unsigned int i=0; i<mExporters.size(); ++i)
+		threads.create_thread(boost::bind(&Downloader::runExporter, this, mExporters[i], boost::cref(outputFolder), &parser));
+	threads.join_all();
+}
 
-		DownloadHelper::saveBinFile(filepath, response_stream, length);			
+void Downloader::runExporter(const Exporter* exporter, const std::string& outputFolder, const Parser* parser)
+{
+	try
+	{
+		(this->*(exporter->function))(outputFolder, parser);
+	}
+	catch (std::exception& e)
+	{
+		boost::mutex::scoped_lock lock(mOutputMutex);
+		*mOutput << "Error while exporting " << exporter->name << ": " << e.what() << std::endl;
+	}
+}
 
-		sock->close();
+unsigned int Downloader::getNbVertex(const std::string& outputFolder, const Parser* parser, unsigned int coordSystemIndex)
+{
+	//point counts are in the bin file headers (read without the vertices)
+	unsigned int nbVertex = 0;
+	BinFileReader reader;
+	for (unsigned int j=0; j<parser->getNbPointCloud(coordSystemIndex); ++j)
+	{
+		if (reader.open(BinFileReader::getFilePath(outputFolder, coordSystemIndex, j)))
+			nbVertex += reader.getNbVertex();
 	}
+
+	return nbVertex;
 }
 
-void Downloader::savePly(const std::string& outputFolder, Parser* parser)
+void Downloader::savePly(const std::string& outputFolder, const Parser* parser)
 {
 	for (unsigned int i=0; i<parser->getNbCoordSystem(); ++i)
-	{		
+	{
+		//vertex counts from the bin file headers (read without the vertices): each ply file is written once
+		unsigned int nbVertex = getNbVertex(outputFolder, parser, i);
+
 		std::stringstream filepath;
 		filepath << outputFolder << "/bin/coord_system_" << i << ".ply";
 
+		PlyWriter points(!mAsciiPly);
 		if (!bf::exists(filepath.str()))
-		{
-			std::ofstream output(filepath.str().c_str());
-			if (output.is_open())
-			{
-				output << "ply" << std::endl;
-				output << "format ascii 1.0" << std::endl;
-				output << "element vertex " << parser->getNbVertex(i) << std::endl;
-				output << "property float x" << std::endl;
-				output << "property float y" << std::endl;
-				output << "property float z" << std::endl;
-				output << "property uchar red" << std::endl;
-				output << "property uchar green" << std::endl;
-				output << "property uchar blue" << std::endl;
-				output << "element face 0" << std::endl;
-				output << "property list uchar int vertex_indices" << std::endl;
-				output << "end_header" << std::endl;
-
-				for (unsigned int j=0; j<parser->getNbPointCloud(i); ++j)
-				{
-					const PointCloud& pointCloud = parser->getPointCloud(i, j);
-					for (unsigned int k=0; k<pointCloud.vertices.size(); ++k)
-					{
-						Ogre::Vector3 pos = pointCloud.vertices[k].position;
-						Ogre::ColourValue color = pointCloud.vertices[k].color;
-						output << pos.x << " " << pos.y << " " << pos.z << " " << (int)(color.r*255.0f) << " " << (int)(color.g*255.0f) << " " << (int)(color.b*255.0f) << std::endl;
-					}				
-				}
-			}
-			output.close();
-		}
+			points.open(filepath.str(), nbVertex);
 
 		filepath.str("");
 		filepath << outputFolder << "/bin/coord_system_" << i << "_with_cameras.ply";
 
+		PlyWriter pointsWithCameras(!mAsciiPly);
 		if (!bf::exists(filepath.str()))
+			pointsWithCameras.open(filepath.str(), nbVertex + 2*parser->getNbCamera(i));
+
+		if (!points.isOpen() && !pointsWithCameras.isOpen())
+			continue;
+
+		//both files share the same points: a single pass streaming each bin file
+		BinFileReader reader;
+		for (unsigned int j=0; j<parser->getNbPointCloud(i); ++j)
 		{
-			std::ofstream output(filepath.str().c_str());
-			if (output.is_open())
+			if (!reader.open(BinFileReader::getFilePath(outputFolder, i, j)))
+				continue;
+
+			float x, y, z;
+			unsigned char red, green, blue;
+			while (reader.readVertex(x, y, z, red, green, blue))
 			{
-				output << "ply" << std::endl;
-				output << "format ascii 1.0" << std::endl;
-				output << "element vertex " << parser->getNbVertex(i) + 2*parser->getNbCamera(i) << std::endl;
-				output << "property float x" << std::endl;
-				output << "property float y" << std::endl;
-				output << "property float z" << std::endl;
-				output << "property uchar red" << std::endl;
-				output << "property uchar green" << std::endl;
-				output << "property uchar blue" << std::endl;
-				output << "element face 0" << std::endl;
-				output << "property list uchar int vertex_indices" << std::endl;
-				output << "end_header" << std::endl;
-
-				for (unsigned int j=0; j<parser->getNbPointCloud(i); ++j)
-				{
-					const PointCloud& pointCloud = parser->getPointCloud(i, j);
-					for (unsigned int k=0; k<pointCloud.vertices.size(); ++k)
-					{
-						Ogre::Vector3 pos = pointCloud.vertices[k].position;
-						Ogre::ColourValue color = pointCloud.vertices[k].color;
-						output << pos.x << " " << pos.y << " " << pos.z << " " << (int)(color.r*255.0f) << " " << (int)(color.g*255.0f) << " " << (int)(color.b*255.0f) << std::endl;
-					}
-				}
+				if (points.isOpen())
+					points.addVertex(x, y, z, red, green, blue);
+				if (pointsWithCameras.isOpen())
+					pointsWithCameras.addVertex(x, y, z, red, green, blue);
+			}
+		}
+		points.close();
 
-				for (unsigned int j=0; j<parser->getNbCamera(i); ++j)
-				{
-					const PhotoSynth::Camera cam = parser->getCamera(i, j);
-					Ogre::Vector3 pos = cam.position;
+		if (pointsWithCameras.isOpen())
+		{
+			for (unsigned int j=0; j<parser->getNbCamera(i); ++j)
+			{
+				const PhotoSynth::Camera& cam = parser->getCamera(i, j);
+				const Ogre::Vector3& pos = cam.position;
 
-					if ((j % 2) == 0)
-						output << pos.x << " " << pos.y << " " << pos.z << " 0 255 0" << std::endl;
-					else
-						output << pos.x << " " << pos.y << " " << pos.z << " 255 0 0" << std::endl;
+				if ((j % 2) == 0)
+					pointsWithCameras.addVertex(pos.x, pos.y, pos.z, 0, 255, 0);
+				else
+					pointsWithCameras.addVertex(pos.x, pos.y, pos.z, 255, 0, 0);
 
-					Ogre::Vector3 offset(0.0f, -0.05f, 0.0f);					
-					Ogre::Vector3 p = pos + cam.orientation.Inverse() * offset;
-					output << p.x << " " << p.y << " " << p.z << " 255 255 0" << std::endl;
-				}
+				Ogre::Vector3 offset(0.0f, -0.05f, 0.0f);
+				Ogre::Vector3 p = pos + cam.orientation.Inverse() * offset;
+				pointsWithCameras.addVertex(p.x, p.y, p.z, 255, 255, 0);
 			}
-			output.close();
+			pointsWithCameras.close();
 		}
 	}
 }
@@ -421,8 +497,8 @@ void Downloader::saveCamerasParameters(const std::string& outputFolder, Parser*
 		std::stringstream filepath;
 		filepath << outputFolder << "/bin/coord_system_" << i << "_cameras.txt";
 
-		std::ofstream output(filepath.str().c_str());
-		if (output.is_open())
+		TextWriter output(filepath.str());
+		if (output.isOpen())
 		{
 			output << nbCamera << std::endl;
 			for (unsigned int j=0; j<nbCamera; ++j)
@@ -467,15 +543,15 @@ void Downloader::saveCamerasParameters(const std::string& outputFolder, Parser*
 
 //This function generate a 3DS Max script (ported from modified version of SynthExport created by Josh Harle in C#)
 //http://blog.neonascent.net/archives/cameraexport-photosynth-to-camera-projection-in-3ds-max/
-void Downloader::save3DSMaxScript(const std::string& outputFolder, Parser* parser)
+void Downloader::save3DSMaxScript(const std::string& outputFolder, const Parser* parser)
 {
 	if (parser->getNbCoordSystem() > 0)
 	{
 		std::stringstream filepath;
 		filepath << outputFolder << "/bin/cameras_max.ms";
 
-		std::ofstream output(filepath.str().c_str());
-		if (output.is_open())
+		TextWriter output(filepath.str());
+		if (output.isOpen())
 		{
 			output << "/* 3DS Max Camera and Projection Map Exporter by Josh Harle (http://tacticalspace.org) */" << std::endl;
 			output << "/*  Enable initial camera states below; 1 = enabled, 0 = disabled */" << std::endl;
@@ -514,8 +590,6 @@ void Downloader::save3DSMaxScript(const std::string& outputFolder, Parser* parse
 
 				output << "Camera" << i << " = freecamera name: \"" << i << "\"" << std::endl;
 				
-				unsigned int precision = output.precision();
-				output.precision(10);
 				output << "Camera" << i << ".fov = cameraFOV.MMtoFOV " << (35 * parser->getCamera(0, i).focal) << std::endl;
 
 				const PhotoSynth::Camera& cam = parser->getCamera(0, i);				
@@ -527,7 +601,6 @@ void Downloader::save3DSMaxScript(const std::string& outputFolder, Parser* parse
 				output << "R.row2 = [" << rot[0][1] << ", " << rot[1][1] << ", " << rot[2][1] << "]" << std::endl;
 				output << "R.row3 = [" << rot[0][2] << ", " << rot[1][2] << ", " << rot[2][2] << "]" << std::endl;
 				output << "t.row4 = [" << pos.x     << ", " << pos.y     << ", " << pos.z     << "]" << std::endl;
-				output.precision(precision);
 				
 				std::string cameratype = "startCamera";
 				std::string wAngle = "0";
@@ -613,15 +686,15 @@ void Downloader::save3DSMaxScript(const std::string& outputFolder, Parser* parse
 		output.close();
 	}
 }
-void Downloader::saveXSIScript(const std::string& outputFolder, Parser* parser)
+void Downloader::saveXSIScript(const std::string& outputFolder, const Parser* parser)
 {
 	if (parser->getNbCoordSystem() > 0)
 	{
 		std::stringstream filepath;
 		filepath << outputFolder << "/bin/cameras_xsi.vbs";
 
-		std::ofstream output(filepath.str().c_str());
-		if (output.is_open())
+		TextWriter output(filepath.str());
+		if (output.isOpen())
 		{			
 			output << "projectPath = \"" << outputFolder << "\"" << std::endl;
 			output << "" << std::endl;
@@ -875,7 +948,7 @@ VertexIndex::VertexIndex(unsigned int indexA, unsigned int indexB)
 	this->indexB = indexB;
 }
 
-void Downloader::savePlyForManualClustering(const std::string& outputFolder, Parser* parser)
+void Downloader::savePlyForManualClustering(const std::string& outputFolder, const Parser* parser)
 {
 	if (parser->getNbCoordSystem() > 0)
 	{
@@ -24,17 +24,30 @@
 #include <fstream>
 #include <string>
 #include <vector>
+#include <cstdlib>
+#include <algorithm>
+#include <memory>
 
 #include "PhotoSynthDownloader.h"
+#include "PhotoSynthBatchDownloader.h"
 
 int main(int argc, char* argv[])
 {
 	if (argc < 3)
 	{
 		std::cout << "Usage: " << argv[0] << " <guid> <outputFolder> [optional]"<<std::endl;
+		std::cout << "       " << argv[0] << " batch <guidList> <outputFolder> [optional]"<<std::endl;
 		std::cout << "<guid>: PhotoSynth GUID (http://photosynth.net/view.aspx?cid=GUID)"<<std::endl;
-		std::cout << "<outputFolder>: folder in which the synth will be downloaded"<<std::endl;	
+		std::cout << "<guidList>: text file with one PhotoSynth GUID per line"<<std::endl;
+		std::cout << "<outputFolder>: folder in which the synth will be downloaded (batch: one sub-folder per synth)"<<std::endl;	
 		std::cout << "[optional] : thumb (will download thumbs)" <<std::endl;
+		std::cout << "[optional] : ascii (write ascii ply files instead of binary ones)" <<std::endl;
+		std::cout << "[optional] : export=<name>,<name> (only run these exporters, default: all)" <<std::endl;
+		for (unsigned int i=0; i<PhotoSynth::Downloader::nbExporter; ++i)
+			std::cout << "             " << PhotoSynth::Downloader::exporters[i].name << ": " << PhotoSynth::Downloader::exporters[i].description << std::endl;
+		std::cout << "[optional] : timeout=<ms> attempts=<n> backoff=<ms> (network retry policy)" <<std::endl;
+		std::cout << "[optional] : jobs=<n> threads=<n> (batch: synths downloaded simultaneously, shared thumb threads)" <<std::endl;
+		std::cout << "[optional] : cache=<folder> cachesize=<MB> (local cache of downloaded files shared by all projects)" <<std::endl;
 		std::cout <<std::endl;
 		std::cout << "Example: "<<argv[0]<< " 1471c7c7-da12-4859-9289-a2e6d2129319 church thumb"<<std::endl;
 		std::cout << "will download json, thumbs and bin files and put everything in \"church\" folder"<<std::endl;
@@ -42,30 +55,75 @@ int main(int argc, char* argv[])
 		return -1;
 	}
 
-	std::string guid         = argv[1];
-	std::string outputFolder = argv[2];
+	bool batch = (std::string(argv[1]) == "batch");
+	if (batch && argc < 4)
+	{
+		std::cout << "Usage: " << argv[0] << " batch <guidList> <outputFolder> [optional]"<<std::endl;
+		return -1;
+	}
+
+	std::string guid         = batch ? argv[2] : argv[1];
+	std::string outputFolder = batch ? argv[3] : argv[2];
 	bool downloadThumb       = false;
+	bool asciiPly            = false;
+	std::vector<std::string> exporterNames;
+	unsigned int nbJob       = 4;
+	unsigned int nbThread    = 8;
+	PhotoSynth::DownloadPolicy policy;
+	std::string cacheFolder;
+	boost::uintmax_t cacheSize = PhotoSynth::DownloadCache::defaultMaxSize;
 
-	for (int i=1; i<argc; ++i)
+	//options follow the positional arguments (a guid or folder named "thumb" isn't an option)
+	for (int i=(batch ? 4 : 3); i<argc; ++i)
 	{
 		std::string current(argv[i]);
 		if (current == "thumb")
 			downloadThumb = true;
+		else if (current == "ascii")
+			asciiPly = true;
+		else if (current.find("jobs=") == 0)
+			nbJob = (unsigned int) atoi(current.substr(5).c_str());
+		else if (current.find("threads=") == 0)
+			nbThread = (unsigned int) atoi(current.substr(8).c_str());
+		else if (current.find("export=") == 0)
+		{
+			if (!PhotoSynth::Downloader::parseExportArgument(current, exporterNames))
+			{
+				std::cout << "Usage: export=<name>,<name> with <name> in:";
+				for (unsigned int j=0; j<PhotoSynth::Downloader::nbExporter; ++j)
+					std::cout << " " << PhotoSynth::Downloader::exporters[j].name;
+				std::cout << std::endl;
+				return -1;
+			}
+		}
+		else if (!PhotoSynth::DownloadCache::parseArgument(current, cacheFolder, cacheSize))
+			policy.parseArgument(current);
 	}
 
-	boost::asio::io_service* service;
 	try
 	{
-		service = new boost::asio::io_service;
-		service->run();
+		std::auto_ptr<PhotoSynth::DownloadCache> cache;
+		if (!cacheFolder.empty())
+			cache.reset(new PhotoSynth::DownloadCache(cacheFolder, cacheSize));
 
-		PhotoSynth::Downloader downloader(service);
-		downloader.download(guid, outputFolder, downloadThumb);
+		if (batch)
+		{
+			PhotoSynth::BatchDownloader downloader(policy, nbJob, std::max(1u, nbThread), cache.get(), asciiPly, exporterNames);
+			if (!downloader.download(guid, outputFolder, downloadThumb))
+				return 1;
+		}
+		else
+		{
+			PhotoSynth::Downloader downloader(policy, NULL, NULL, cache.get(), asciiPly, exporterNames);
+			if (!downloader.download(guid, outputFolder, downloadThumb))
+				return 1;
+		}
 	}
 	catch(std::exception& e)
 	{
 		std::cout << e.what() << std::endl;
+		return 1;
 	}
 
 	return 0;
-}
\ No newline at end of file
+}
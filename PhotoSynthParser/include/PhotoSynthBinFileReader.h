@@ -0,0 +1,74 @@
+/*
+	Copyright (c) 2010 ASTRE Henri (http://www.visual-experiments.com)
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+	THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include "PhotoSynthStructures.h"
+
+namespace PhotoSynth
+{
+	//Read a points_<coordSystem>_<binFile>.bin file vertex by vertex through a fixed size buffer:
+	//vertices can be streamed to an exporter without keeping the point cloud in memory.
+	//Format converted (C# -> C++) from SynthExport (http://synthexport.codeplex.com/): big-endian,
+	//version 1.0, per image observations (compressed ints) then vertices (3 floats + rgb565).
+	class BinFileReader
+	{
+		public:
+			BinFileReader(std::size_t bufferSize = defaultBufferSize);
+
+			static std::string getFilePath(const std::string& inputPath, unsigned int coordSystemIndex, unsigned int binFileIndex);
+
+			//read the header and the observations (kept in infos if not NULL, skipped otherwise)
+			bool open(const std::string& filepath, std::vector<std::vector<VertexInfo> >* infos = NULL);
+			void close();
+
+			unsigned int getNbVertex() const;
+
+			//return false once all vertices are read or if the file is truncated
+			bool readVertex(float& x, float& y, float& z, unsigned char& red, unsigned char& green, unsigned char& blue);
+
+			static const std::size_t defaultBufferSize = 64*1024;
+
+		protected:
+			inline unsigned char readByte()
+			{
+				if (mPosition == mSize && !fill())
+					return 0;
+				return (unsigned char) mBuffer[mPosition++];
+			}
+			bool fill();
+			int readCompressedInt();
+			float readBigEndianSingle();
+			unsigned int readBigEndianUInt16();
+
+			std::ifstream mInput;
+			std::vector<char> mBuffer;
+			std::size_t mPosition;
+			std::size_t mSize;
+			bool mEndOfFile;
+			unsigned int mNbVertex;
+			unsigned int mNbVertexRead;
+	};
+}
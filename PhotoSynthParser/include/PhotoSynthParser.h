@@ -91,10 +91,6 @@ namespace PhotoSynth
 
 			std::vector<CoordSystem> mCoordSystems;
 
-			//Converted (C# -> C++) from SynthExport (http://synthexport.codeplex.com/)
 			bool loadBinFile(const std::string& inputPath, unsigned int coordSystemIndex, unsigned int binFileIndex);
-			int ReadCompressedInt(std::istream& input);
-			float ReadBigEndianSingle(std::istream& input);
-			unsigned int ReadBigEndianUInt16(std::istream& input);
 	};
 }
\ No newline at end of file
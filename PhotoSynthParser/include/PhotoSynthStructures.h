@@ -63,6 +63,8 @@ namespace PhotoSynth
 		Ogre::Vector3 position;
 	};
 
+	//observation of a vertex by one camera, stored in PointCloud::infos[k] where k is the position
+	//of the camera in its CoordSystem (cameras[k]), not the picture index: use cameras[k].index for that
 	struct VertexInfo
 	{
 		VertexInfo();
@@ -75,7 +77,7 @@ namespace PhotoSynth
 	struct PointCloud
 	{
 		std::vector<Vertex> vertices;
-		std::vector<std::vector<VertexInfo>> infos; //one vector<VertexInfo> per image
+		std::vector<std::vector<VertexInfo>> infos; //one vector<VertexInfo> per camera of the CoordSystem
 	};
 
 	struct CoordSystem
@@ -0,0 +1,99 @@
+/*
+	Copyright (c) 2010 ASTRE Henri (http://www.visual-experiments.com)
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+	THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <ostream>
+
+namespace PhotoSynth
+{
+	//Locale independent number formatting ('.' decimal separator whatever the C/C++ locale).
+	//Functions write at most maxSize characters in buffer (not null terminated) and return the number written.
+	class NumberFormat
+	{
+		public:
+			//fewest significant digits (up to 9) that read back to the same float: 0.1f -> "0.1"
+			static unsigned int formatFloat(float value, char* buffer);
+
+			//15 significant digits, trailing zeros removed (like "%.15g")
+			static unsigned int formatDouble(double value, char* buffer);
+
+			//nbDecimal digits after the decimal point (like "%.6f" for nbDecimal = 6)
+			static unsigned int formatFixed(double value, unsigned int nbDecimal, char* buffer);
+
+			static unsigned int formatInt(long long value, char* buffer);
+			static unsigned int formatUInt(unsigned long long value, char* buffer);
+
+			static const unsigned int maxSize = 40;
+
+		protected:
+			static unsigned int formatSignificant(double value, unsigned int nbDigit, bool shortestFloat, char* buffer);
+	};
+
+	//Buffered text file writer formatting numbers with NumberFormat: drop-in replacement for the
+	//std::ofstream << chains of the exporters, std::endl only ends the line (no flush).
+	class TextWriter
+	{
+		public:
+			TextWriter(std::size_t bufferSize = defaultBufferSize);
+			TextWriter(const std::string& filepath, std::size_t bufferSize = defaultBufferSize);
+			~TextWriter();
+
+			bool open(const std::string& filepath);
+			bool isOpen() const;
+			void close();
+
+			TextWriter& write(const char* data, std::size_t size);
+			TextWriter& writeFixed(double value, unsigned int nbDecimal);
+
+			TextWriter& operator<<(const char* text);
+			TextWriter& operator<<(const std::string& text);
+			TextWriter& operator<<(char c);
+			TextWriter& operator<<(int value);
+			TextWriter& operator<<(unsigned int value);
+			TextWriter& operator<<(long value);
+			TextWriter& operator<<(unsigned long value);
+			TextWriter& operator<<(long long value);
+			TextWriter& operator<<(unsigned long long value);
+			TextWriter& operator<<(float value);
+			TextWriter& operator<<(double value);
+			TextWriter& operator<<(std::ostream& (*manipulator)(std::ostream&)); //std::endl
+
+			static const std::size_t defaultBufferSize = 64*1024;
+
+		protected:
+			inline char* reserve(std::size_t size)
+			{
+				if (mSize + size > mBuffer.size())
+					flush();
+				return &mBuffer[mSize];
+			}
+			void flush();
+
+			std::ofstream mOutput;
+			std::vector<char> mBuffer;
+			std::size_t mSize;
+	};
+}
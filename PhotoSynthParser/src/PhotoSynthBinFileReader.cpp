@@ -0,0 +1,181 @@
+/*
+	Copyright (c) 2010 ASTRE Henri (http://www.visual-experiments.com)
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+	THE SOFTWARE.
+*/
+
+#include "PhotoSynthBinFileReader.h"
+
+#include <sstream>
+#include <cstring>
+
+using namespace PhotoSynth;
+
+const std::size_t BinFileReader::defaultBufferSize;
+
+BinFileReader::BinFileReader(std::size_t bufferSize)
+{
+	mBuffer.resize(bufferSize > 0 ? bufferSize : 1);
+	mPosition     = 0;
+	mSize         = 0;
+	mEndOfFile    = false;
+	mNbVertex     = 0;
+	mNbVertexRead = 0;
+}
+
+std::string BinFileReader::getFilePath(const std::string& inputPath, unsigned int coordSystemIndex, unsigned int binFileIndex)
+{
+	std::stringstream filepath;
+	filepath << inputPath << "/bin/points_" << coordSystemIndex << "_" << binFileIndex << ".bin";
+
+	return filepath.str();
+}
+
+bool BinFileReader::open(const std::string& filepath, std::vector<std::vector<VertexInfo> >* infos)
+{
+	close();
+
+	mInput.open(filepath.c_str(), std::ios::binary);
+	if (!mInput.is_open())
+		return false;
+
+	unsigned int versionMajor = readBigEndianUInt16();
+	unsigned int versionMinor = readBigEndianUInt16();
+	if (versionMajor != 1 || versionMinor != 0)
+	{
+		close();
+		return false;
+	}
+
+	int nbImage = readCompressedInt();
+	if (infos)
+		*infos = std::vector<std::vector<VertexInfo> >(nbImage);
+	for (int i=0; i<nbImage && !mEndOfFile; i++)
+	{
+		int nbInfo = readCompressedInt();
+		if (infos)
+			(*infos)[i].resize(nbInfo);
+
+		for (int j=0; j<nbInfo && !mEndOfFile; j++)
+		{
+			int vertexIndex = readCompressedInt();
+			int vertexValue = readCompressedInt();
+			if (infos)
+				(*infos)[i][j] = VertexInfo(vertexIndex, vertexValue);
+		}
+	}
+
+	mNbVertex = (unsigned int) readCompressedInt();
+	if (mEndOfFile)
+	{
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+void BinFileReader::close()
+{
+	if (mInput.is_open())
+		mInput.close();
+	mInput.clear();
+	mPosition     = 0;
+	mSize         = 0;
+	mEndOfFile    = false;
+	mNbVertex     = 0;
+	mNbVertexRead = 0;
+}
+
+unsigned int BinFileReader::getNbVertex() const
+{
+	return mNbVertex;
+}
+
+bool BinFileReader::readVertex(float& x, float& y, float& z, unsigned char& red, unsigned char& green, unsigned char& blue)
+{
+	if (mNbVertexRead >= mNbVertex)
+		return false;
+
+	x = readBigEndianSingle();
+	y = readBigEndianSingle();
+	z = readBigEndianSingle();
+
+	unsigned int color = readBigEndianUInt16();
+	red   = (unsigned char) (((color >> 11) * 255) / 31);
+	green = (unsigned char) ((((color >> 5) & 63) * 255) / 63);
+	blue  = (unsigned char) (((color & 31) * 255) / 31);
+
+	if (mEndOfFile)
+		return false;
+
+	mNbVertexRead++;
+	return true;
+}
+
+bool BinFileReader::fill()
+{
+	mPosition = 0;
+	mSize     = 0;
+	if (mInput.is_open() && !mInput.eof())
+	{
+		mInput.read(&mBuffer[0], mBuffer.size());
+		mSize = (std::size_t) mInput.gcount();
+	}
+	mEndOfFile = (mSize == 0);
+
+	return !mEndOfFile;
+}
+
+int BinFileReader::readCompressedInt()
+{
+	//7 bits per byte, most significant first, the last byte has its high bit set
+	int i = 0;
+	unsigned char b;
+	do
+	{
+		b = readByte();
+		i = (i << 7) | (b & 127);
+	}
+	while (b < 128 && !mEndOfFile);
+
+	return i;
+}
+
+float BinFileReader::readBigEndianSingle()
+{
+	unsigned char b[4];
+	b[3] = readByte();
+	b[2] = readByte();
+	b[1] = readByte();
+	b[0] = readByte();
+
+	float result;
+	memcpy(&result, b, sizeof(result));
+
+	return result;
+}
+
+unsigned int BinFileReader::readBigEndianUInt16()
+{
+	unsigned int b1 = readByte();
+	unsigned int b2 = readByte();
+
+	return (b1 << 8) | b2;
+}
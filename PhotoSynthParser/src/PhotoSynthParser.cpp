@@ -21,6 +21,7 @@
 */
 
 #include "PhotoSynthParser.h"
+#include "PhotoSynthBinFileReader.h"
 #include <OgreStringVector.h>
 
 #include <tinyxml.h>
@@ -230,103 +231,20 @@ std::string Parser::getGuid(const std::string& filepath)
 	return line;
 }
 
-int Parser::ReadCompressedInt(std::istream& input)
-{
-	int i = 0;
-	unsigned char b;
-
-	do
-	{
-		input.read((char*)&b, sizeof(b));
-		i = (i << 7) | (b & 127);
-	} while (b < 128);
-
-	return i;
-}
-
-float Parser::ReadBigEndianSingle(std::istream& input)
-{
-	unsigned char b1[4];
-	unsigned char b2[4];
-
-	input.read((char*)b1, sizeof(b1));
-	b2[0] = b1[3];
-	b2[1] = b1[2];
-	b2[2] = b1[1];
-	b2[3] = b1[0];
-
-	float result = *((float*) b2);
-	return 	result;
-}
-
-unsigned int Parser::ReadBigEndianUInt16(std::istream& input)
-{
-	unsigned int value;
-
-	unsigned char b1, b2;
-	input.read((char*)&b1, sizeof(b1));
-	input.read((char*)&b2, sizeof(b2));
-
-	value = (b2 | b1 << 8);
-
-	return value;
-}
-
 bool Parser::loadBinFile(const std::string& inputPath, unsigned int coordSystemIndex, unsigned int binFileIndex)
 {
-	std::stringstream filename;
-	filename << inputPath << "/bin/points_" << coordSystemIndex << "_" << binFileIndex << ".bin";
+	PointCloud& pointCloud = mCoordSystems[coordSystemIndex].pointClouds[binFileIndex];
 
-	std::ifstream input;
-	input.open(filename.str().c_str(), std::ios::binary);
-	if (input.is_open())
-	{
-		unsigned int versionMajor = ReadBigEndianUInt16(input);
-		unsigned int versionMinor = ReadBigEndianUInt16(input);
+	BinFileReader reader;
+	if (!reader.open(BinFileReader::getFilePath(inputPath, coordSystemIndex, binFileIndex), &pointCloud.infos))
+		return false;
 
-		if (versionMajor != 1 || versionMinor != 0)
-		{
-			input.close();
-			return false;
-		}
-
-		int nbImage = ReadCompressedInt(input);
-		mCoordSystems[coordSystemIndex].pointClouds[binFileIndex].infos = std::vector<std::vector<VertexInfo>>(nbImage);
-		for (int i=0; i<nbImage; i++)
-		{
-			int nbInfo = ReadCompressedInt(input);
-			mCoordSystems[coordSystemIndex].pointClouds[binFileIndex].infos[i] = std::vector<VertexInfo>(nbInfo);
-
-			for (int j=0; j<nbInfo; j++)
-			{
-				int vertexIndex = ReadCompressedInt(input);
-				int vertexValue = ReadCompressedInt(input);
-
-				mCoordSystems[coordSystemIndex].pointClouds[binFileIndex].infos[i][j] = VertexInfo(vertexIndex, vertexValue);
-			}
-		}
+	pointCloud.vertices = std::vector<Vertex>(reader.getNbVertex());
 
-		int nbVertex = ReadCompressedInt(input);
-		mCoordSystems[coordSystemIndex].pointClouds[binFileIndex].vertices = std::vector<Vertex>(nbVertex);
-
-		for (int i=0; i<nbVertex; i++)
-		{
-			float x = ReadBigEndianSingle(input);
-			float y = ReadBigEndianSingle(input);
-			float z = ReadBigEndianSingle(input);
-			Ogre::Vector3 position(x, y, z);
-
-			unsigned int color = ReadBigEndianUInt16(input);
-
-			unsigned char r = (unsigned char) (((color >> 11) * 255) / 31);
-			unsigned char g = (unsigned char) ((((color >> 5) & 63) * 255) / 63);
-			unsigned char b = (unsigned char) (((color & 31) * 255) / 31);
-			Ogre::ColourValue colorValue(r/255.0f, g/255.0f, b/255.0f, 1.0f);
-
-			mCoordSystems[coordSystemIndex].pointClouds[binFileIndex].vertices[i] = Vertex(position, colorValue);
-		}
-	}
-	input.close();
+	float x, y, z;
+	unsigned char r, g, b;
+	for (unsigned int i=0; i<pointCloud.vertices.size() && reader.readVertex(x, y, z, r, g, b); i++)
+		pointCloud.vertices[i] = Vertex(Ogre::Vector3(x, y, z), Ogre::ColourValue(r/255.0f, g/255.0f, b/255.0f, 1.0f));
 
 	return true;
 }
\ No newline at end of file
@@ -0,0 +1,409 @@
+/*
+	Copyright (c) 2010 ASTRE Henri (http://www.visual-experiments.com)
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+	THE SOFTWARE.
+*/
+
+#include "PhotoSynthTextWriter.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+using namespace PhotoSynth;
+
+const unsigned int NumberFormat::maxSize;
+const std::size_t TextWriter::defaultBufferSize;
+
+namespace
+{
+	const double doublePowers[] = 
+	{
+		1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+	const unsigned long long integerPowers[] =
+	{
+		1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL, 100000000ULL, 1000000000ULL,
+		10000000000ULL, 100000000000ULL, 1000000000000ULL, 10000000000000ULL, 100000000000000ULL,
+		1000000000000000ULL, 10000000000000000ULL, 100000000000000000ULL
+	};
+
+	//value * 10^exponent, exact powers of ten are used by steps of 10^22 (no overflow of the power itself)
+	double scale(double value, int exponent)
+	{
+		while (exponent > 22)
+		{
+			value    *= 1e22;
+			exponent -= 22;
+		}
+		while (exponent < -22)
+		{
+			value    /= 1e22;
+			exponent += 22;
+		}
+
+		return exponent >= 0 ? value * doublePowers[exponent] : value / doublePowers[-exponent];
+	}
+
+	unsigned int copyText(const char* text, char* buffer)
+	{
+		unsigned int length = (unsigned int) strlen(text);
+		memcpy(buffer, text, length);
+
+		return length;
+	}
+}
+
+unsigned int NumberFormat::formatFloat(float value, char* buffer)
+{
+	return formatSignificant(value, 9, true, buffer);
+}
+
+unsigned int NumberFormat::formatDouble(double value, char* buffer)
+{
+	return formatSignificant(value, 15, false, buffer);
+}
+
+unsigned int NumberFormat::formatSignificant(double value, unsigned int nbDigit, bool shortestFloat, char* buffer)
+{
+	char* output = buffer;
+
+	if (value != value)
+		return copyText("nan", buffer);
+	if (value < 0)
+	{
+		*output++ = '-';
+		value = -value;
+	}
+	if (value == 0)
+	{
+		*output++ = '0';
+		return (unsigned int) (output - buffer);
+	}
+	if (value > 1.7976931348623157e308)
+		return (unsigned int) (output - buffer) + copyText("inf", output);
+
+	unsigned long long digits = 0;
+	int digitsExponent = 0;
+	if (shortestFloat)
+	{
+		//17 significant digits of value: 10^16 <= significand < 10^17
+		//floor(log10(value)) is either exponent or exponent+1 (log10(2^(e2-1)) <= log10(value) < log10(2^e2))
+		int e2;
+		frexp(value, &e2);
+		int exponent = (int) floor((e2 - 1) * 0.30102999566398120);
+		double scaled = scale(value, 16 - exponent);
+		if (scaled >= 1e17)
+		{
+			exponent++;
+			scaled = scale(value, 16 - exponent);
+		}
+		unsigned long long significand = (unsigned long long) (scaled + 0.5);
+		if (significand >= integerPowers[17])
+		{
+			significand /= 10;
+			exponent++;
+		}
+
+		//round to n digits: smallest n that reads back to the same float
+		//(scale is not exact for doubles but the float round-trip check makes it safe here)
+		for (unsigned int n=1; n<=nbDigit; ++n)
+		{
+			unsigned long long divisor = integerPowers[17 - n];
+			digits = (significand + divisor/2) / divisor;
+			digitsExponent = exponent;
+			if (digits >= integerPowers[n]) //9.96 -> 10.0
+			{
+				digits /= 10;
+				digitsExponent++;
+			}
+
+			if ((float) scale((double) digits, digitsExponent - (int) n + 1) == (float) value)
+				break;
+		}
+	}
+	else
+	{
+		//correctly rounded digits from the C library: "d.dddde+xx", the decimal separator (locale dependent) is skipped
+		char scientific[maxSize];
+		sprintf(scientific, "%.*e", (int) nbDigit - 1, value);
+		const char* c = scientific;
+		for (; *c != 'e' && *c != '\0'; ++c)
+		{
+			if (*c >= '0' && *c <= '9')
+				digits = digits * 10 + (unsigned long long) (*c - '0');
+		}
+		digitsExponent = (*c == 'e') ? atoi(c + 1) : 0;
+	}
+
+	//digits without trailing zeros, most significant first
+	while (digits >= 10 && digits % 10 == 0)
+		digits /= 10;
+	char text[20] = {0};
+	unsigned int length = 0;
+	for (unsigned long long d = digits; d > 0; d /= 10)
+		text[length++] = (char) ('0' + d % 10);
+	std::reverse(text, text + length);
+
+	if (digitsExponent < -4 || digitsExponent >= (int) nbDigit)
+	{
+		//scientific notation like printf: 1.5e-07, 1e+20
+		*output++ = text[0];
+		if (length > 1)
+		{
+			*output++ = '.';
+			memcpy(output, text + 1, length - 1);
+			output += length - 1;
+		}
+		*output++ = 'e';
+		*output++ = digitsExponent < 0 ? '-' : '+';
+		int absExponent = digitsExponent < 0 ? -digitsExponent : digitsExponent;
+		if (absExponent < 10)
+			*output++ = '0';
+		output += formatUInt(absExponent, output);
+	}
+	else if (digitsExponent < 0)
+	{
+		//0.000123
+		*output++ = '0';
+		*output++ = '.';
+		for (int i=0; i<-digitsExponent-1; ++i)
+			*output++ = '0';
+		memcpy(output, text, length);
+		output += length;
+	}
+	else
+	{
+		//123, 12.3, 12300
+		unsigned int nbIntegerDigit = (unsigned int) digitsExponent + 1;
+		for (unsigned int i=0; i<nbIntegerDigit; ++i)
+			*output++ = i < length ? text[i] : '0';
+		if (length > nbIntegerDigit)
+		{
+			*output++ = '.';
+			memcpy(output, text + nbIntegerDigit, length - nbIntegerDigit);
+			output += length - nbIntegerDigit;
+		}
+	}
+
+	return (unsigned int) (output - buffer);
+}
+
+unsigned int NumberFormat::formatFixed(double value, unsigned int nbDecimal, char* buffer)
+{
+	nbDecimal = std::min(nbDecimal, 16u);
+	double scaled = fabs(value) * doublePowers[nbDecimal];
+
+	//too large for an exact integer: use significant digits instead
+	if (value != value || scaled >= 9e15)
+		return formatDouble(value, buffer);
+
+	char* output = buffer;
+	if (value < 0)
+		*output++ = '-';
+
+	unsigned long long rounded = (unsigned long long) (scaled + 0.5);
+	output += formatUInt(rounded / integerPowers[nbDecimal], output);
+	if (nbDecimal > 0)
+	{
+		*output++ = '.';
+		unsigned long long decimals = rounded % integerPowers[nbDecimal];
+		for (unsigned int i=nbDecimal; i>0; --i)
+		{
+			output[i-1] = (char) ('0' + decimals % 10);
+			decimals /= 10;
+		}
+		output += nbDecimal;
+	}
+
+	return (unsigned int) (output - buffer);
+}
+
+unsigned int NumberFormat::formatInt(long long value, char* buffer)
+{
+	if (value >= 0)
+		return formatUInt((unsigned long long) value, buffer);
+
+	buffer[0] = '-';
+	return 1 + formatUInt(0ULL - (unsigned long long) value, buffer + 1);
+}
+
+unsigned int NumberFormat::formatUInt(unsigned long long value, char* buffer)
+{
+	char text[20];
+	unsigned int length = 0;
+	do
+	{
+		text[length++] = (char) ('0' + value % 10);
+		value /= 10;
+	}
+	while (value > 0);
+
+	for (unsigned int i=0; i<length; ++i)
+		buffer[i] = text[length-1-i];
+
+	return length;
+}
+
+TextWriter::TextWriter(std::size_t bufferSize)
+{
+	mBuffer.resize(std::max(bufferSize, (std::size_t) NumberFormat::maxSize));
+	mSize = 0;
+}
+
+TextWriter::TextWriter(const std::string& filepath, std::size_t bufferSize)
+{
+	mBuffer.resize(std::max(bufferSize, (std::size_t) NumberFormat::maxSize));
+	mSize = 0;
+	open(filepath);
+}
+
+TextWriter::~TextWriter()
+{
+	close();
+}
+
+bool TextWriter::open(const std::string& filepath)
+{
+	close();
+	mOutput.open(filepath.c_str());
+
+	return mOutput.is_open();
+}
+
+bool TextWriter::isOpen() const
+{
+	return mOutput.is_open();
+}
+
+void TextWriter::close()
+{
+	if (!mOutput.is_open())
+		return;
+
+	flush();
+	mOutput.close();
+}
+
+void TextWriter::flush()
+{
+	if (mSize > 0 && mOutput.is_open())
+		mOutput.write(&mBuffer[0], mSize);
+	mSize = 0;
+}
+
+TextWriter& TextWriter::write(const char* data, std::size_t size)
+{
+	if (size > mBuffer.size())
+	{
+		flush();
+		mOutput.write(data, size);
+	}
+	else
+	{
+		memcpy(reserve(size), data, size);
+		mSize += size;
+	}
+
+	return *this;
+}
+
+TextWriter& TextWriter::writeFixed(double value, unsigned int nbDecimal)
+{
+	mSize += NumberFormat::formatFixed(value, nbDecimal, reserve(NumberFormat::maxSize));
+	return *this;
+}
+
+TextWriter& TextWriter::operator<<(const char* text)
+{
+	return write(text, strlen(text));
+}
+
+TextWriter& TextWriter::operator<<(const std::string& text)
+{
+	return write(text.c_str(), text.size());
+}
+
+TextWriter& TextWriter::operator<<(char c)
+{
+	*reserve(1) = c;
+	mSize++;
+	return *this;
+}
+
+TextWriter& TextWriter::operator<<(int value)
+{
+	mSize += NumberFormat::formatInt(value, reserve(NumberFormat::maxSize));
+	return *this;
+}
+
+TextWriter& TextWriter::operator<<(unsigned int value)
+{
+	mSize += NumberFormat::formatUInt(value, reserve(NumberFormat::maxSize));
+	return *this;
+}
+
+TextWriter& TextWriter::operator<<(long value)
+{
+	mSize += NumberFormat::formatInt(value, reserve(NumberFormat::maxSize));
+	return *this;
+}
+
+TextWriter& TextWriter::operator<<(unsigned long value)
+{
+	mSize += NumberFormat::formatUInt(value, reserve(NumberFormat::maxSize));
+	return *this;
+}
+
+TextWriter& TextWriter::operator<<(long long value)
+{
+	mSize += NumberFormat::formatInt(value, reserve(NumberFormat::maxSize));
+	return *this;
+}
+
+TextWriter& TextWriter::operator<<(unsigned long long value)
+{
+	mSize += NumberFormat::formatUInt(value, reserve(NumberFormat::maxSize));
+	return *this;
+}
+
+TextWriter& TextWriter::operator<<(float value)
+{
+	mSize += NumberFormat::formatFloat(value, reserve(NumberFormat::maxSize));
+	return *this;
+}
+
+TextWriter& TextWriter::operator<<(double value)
+{
+	mSize += NumberFormat::formatDouble(value, reserve(NumberFormat::maxSize));
+	return *this;
+}
+
+TextWriter& TextWriter::operator<<(std::ostream& (*manipulator)(std::ostream&))
+{
+	//only std::endl is meaningful for a text file, without the flush
+	if (manipulator == static_cast<std::ostream& (*)(std::ostream&)>(std::endl))
+		*this << '\n';
+
+	return *this;
+}
@@ -0,0 +1,165 @@
+/*
+	Copyright (c) 2010 ASTRE Henri (http://www.visual-experiments.com)
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+	THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+namespace PhotoSynth
+{
+	//Header driven PLY reader: the file is memory-mapped and the header is parsed into a schema
+	//(elements, typed properties in file order, list properties, endianness).
+	//Properties of an element are decoded straight into caller provided arrays (Field: destination + stride)
+	//using the offset of each property in a binary record; a property whose type matches the destination
+	//in a little-endian file is copied without conversion.
+	class PlyReader
+	{
+		public:
+			enum Format
+			{
+				ASCII,
+				BINARY_LITTLE_ENDIAN,
+				BINARY_BIG_ENDIAN
+			};
+
+			enum Type
+			{
+				INT8,
+				UINT8,
+				INT16,
+				UINT16,
+				INT32,
+				UINT32,
+				FLOAT32,
+				FLOAT64,
+				INVALID
+			};
+
+			struct Property
+			{
+				std::string name;
+				Type type;           //value type, or item type of a list
+				bool isList;
+				Type countType;      //list only
+				unsigned int offset; //binary record offset, valid until the first list property of the element
+			};
+
+			struct Element
+			{
+				const Property* getProperty(const std::string& name) const;
+
+				std::string name;
+				unsigned int count;
+				std::vector<Property> properties;
+				unsigned int stride; //binary record size, 0 if the element has list properties
+			};
+
+			//destination of a decoded property: value i is written at destination + i*stride bytes
+			struct Field
+			{
+				Field(const std::string& property, float* destination, std::size_t stride, float scale = 1.0f);
+				Field(const std::string& property, int* destination, std::size_t stride);
+				Field(const std::string& property, unsigned int* destination, std::size_t stride);
+
+				std::string property;
+				void* destination;
+				Type destinationType; //FLOAT32, INT32 or UINT32
+				std::size_t stride;
+				float scale;          //FLOAT32 only
+			};
+
+			PlyReader();
+			~PlyReader();
+
+			bool open(const std::string& filepath);
+			void close();
+
+			Format getFormat() const;
+			const std::vector<Element>& getElements() const;
+			const Element* getElement(const std::string& name) const;
+
+			//decode the fields of every record of element, properties missing in the file are ignored
+			bool read(const std::string& elementName, const std::vector<Field>& fields);
+
+			//decode a list property: counts[i] items of record i are appended to items
+			bool readList(const std::string& elementName, const std::string& propertyName, std::vector<unsigned int>& counts, std::vector<int>& items);
+
+			//first record of a binary element without list properties, inside the mapped file (NULL otherwise).
+			//Records are Element::stride bytes apart, each property at Property::offset, in file endianness.
+			const char* getRecords(const std::string& elementName) const;
+
+			static Type getType(const std::string& name);
+			static unsigned int getTypeSize(Type type);
+
+		protected:
+			struct Decoder
+			{
+				Type type;
+				unsigned int offset;   //binary
+				unsigned int property; //index of the property in the record
+				void* destination;
+				Type destinationType;
+				std::size_t stride;
+				float scale;
+				bool isCopy;           //binary value copied as is
+			};
+
+			struct ListDecoder
+			{
+				unsigned int property;
+				std::vector<unsigned int>* counts;
+				std::vector<int>* items;
+			};
+
+			bool parseHeader();
+			const char* findElement(const std::string& elementName, const Element*& element) const;
+			const char* skipElement(const Element& element, const char* data) const;
+			bool readBinary(const Element& element, const char* data, const std::vector<Decoder>& decoders, const ListDecoder* list) const;
+			bool readAscii(const Element& element, const char* data, const std::vector<Decoder>& decoders, const ListDecoder* list) const;
+			const char* skipBinaryRecord(const Element& element, const char* data) const;
+			double decodeBinary(Type type, const char* data) const;
+
+			static inline void store(const Decoder& decoder, unsigned int index, double value)
+			{
+				char* destination = (char*) decoder.destination + index * decoder.stride;
+				switch (decoder.destinationType)
+				{
+					case INT32:  *(int*) destination          = (int) value;                  break;
+					case UINT32: *(unsigned int*) destination = (unsigned int) value;         break;
+					default:     *(float*) destination        = (float) value * decoder.scale; break;
+				}
+			}
+
+			static const char* parseNumber(const char* data, const char* end, double& value);
+
+			boost::interprocess::file_mapping*  mFile;
+			boost::interprocess::mapped_region* mRegion;
+			const char* mBegin;
+			const char* mEnd;
+			const char* mBody; //first byte after end_header
+			Format mFormat;
+			std::vector<Element> mElements;
+	};
+}
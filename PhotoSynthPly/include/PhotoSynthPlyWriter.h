@@ -0,0 +1,104 @@
+/*
+	Copyright (c) 2010 ASTRE Henri (http://www.visual-experiments.com)
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+	THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstring>
+#include <PhotoSynthTextWriter.h>
+
+namespace PhotoSynth
+{
+	//Write colored point clouds (x y z red green blue) to PLY files.
+	//Vertices are formatted into a large buffer which is written in one call when full:
+	//no per vertex stream formatting nor flush. Binary files are little-endian (x86), ascii coordinates
+	//are written with the fewest digits that read back to the same float (NumberFormat).
+	class PlyWriter
+	{
+		public:
+			PlyWriter(bool binary = true, std::size_t bufferSize = defaultBufferSize);
+			~PlyWriter(); //discard the file if close() was not called
+
+			//the file is written to filepath.tmp and renamed by close(), so an interrupted export never leaves a partial filepath
+			//nbVertex = unknownNbVertex (or a count that doesn't match the vertices added): close() copies the vertices
+			//after a new header, give the count whenever it is known to write each file only once
+			bool open(const std::string& filepath, unsigned int nbVertex = unknownNbVertex);
+			bool isOpen() const;
+			void close();
+
+			unsigned int getNbVertex() const; //vertices added since open
+
+			inline void addVertex(float x, float y, float z, unsigned char red, unsigned char green, unsigned char blue)
+			{
+				if (mSize + maxVertexSize > mBuffer.size())
+					flush();
+				mNbVertex++;
+				if (mBinary)
+				{
+					float position[3] = { x, y, z };
+					memcpy(&mBuffer[mSize], position, sizeof(position));
+					mBuffer[mSize+12] = (char) red;
+					mBuffer[mSize+13] = (char) green;
+					mBuffer[mSize+14] = (char) blue;
+					mSize += binaryVertexSize;
+				}
+				else
+				{
+					char* output = &mBuffer[mSize];
+					output += NumberFormat::formatFloat(x, output);
+					*output++ = ' ';
+					output += NumberFormat::formatFloat(y, output);
+					*output++ = ' ';
+					output += NumberFormat::formatFloat(z, output);
+					*output++ = ' ';
+					output += NumberFormat::formatUInt(red, output);
+					*output++ = ' ';
+					output += NumberFormat::formatUInt(green, output);
+					*output++ = ' ';
+					output += NumberFormat::formatUInt(blue, output);
+					*output++ = '\n';
+					mSize = output - &mBuffer[0];
+				}
+			}
+
+			static const std::size_t defaultBufferSize = 1024*1024;
+			static const std::size_t binaryVertexSize  = 3*sizeof(float) + 3;
+			static const std::size_t maxVertexSize     = 3*NumberFormat::maxSize + 3*4 + 1; //ascii: 3 floats + 3 uchar
+			static const unsigned int unknownNbVertex  = 0xFFFFFFFF;
+
+		protected:
+			void flush();
+			void writeHeader(std::ostream& output, unsigned int nbVertex) const;
+
+			std::ofstream mOutput;
+			bool mBinary;
+			std::vector<char> mBuffer;
+			std::size_t mSize;
+			unsigned int mNbVertex;
+			std::string mFilepath;
+			std::string mDataFilepath;  //filepath.tmp
+			unsigned int mHeaderNbVertex; //count written in the header of the data file, unknownNbVertex: no header
+			std::streamoff mHeaderSize;
+	};
+}
@@ -0,0 +1,663 @@
+/*
+	Copyright (c) 2010 ASTRE Henri (http://www.visual-experiments.com)
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+	THE SOFTWARE.
+*/
+
+#include "PhotoSynthPlyReader.h"
+
+#include <sstream>
+#include <cstring>
+#include <algorithm>
+
+using namespace PhotoSynth;
+using namespace boost::interprocess;
+
+namespace
+{
+	const double powers[] = 
+	{
+		1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+	inline bool isSpace(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+	}
+
+	inline const char* skipToken(const char* data, const char* end)
+	{
+		while (data < end && isSpace(*data))
+			data++;
+		if (data == end)
+			return NULL;
+		while (data < end && !isSpace(*data))
+			data++;
+
+		return data;
+	}
+}
+
+PlyReader::Field::Field(const std::string& property, float* destination, std::size_t stride, float scale)
+{
+	this->property        = property;
+	this->destination     = destination;
+	this->destinationType = FLOAT32;
+	this->stride          = stride;
+	this->scale           = scale;
+}
+
+PlyReader::Field::Field(const std::string& property, int* destination, std::size_t stride)
+{
+	this->property        = property;
+	this->destination     = destination;
+	this->destinationType = INT32;
+	this->stride          = stride;
+	this->scale           = 1.0f;
+}
+
+PlyReader::Field::Field(const std::string& property, unsigned int* destination, std::size_t stride)
+{
+	this->property        = property;
+	this->destination     = destination;
+	this->destinationType = UINT32;
+	this->stride          = stride;
+	this->scale           = 1.0f;
+}
+
+const PlyReader::Property* PlyReader::Element::getProperty(const std::string& name) const
+{
+	for (unsigned int i=0; i<properties.size(); ++i)
+	{
+		if (properties[i].name == name)
+			return &properties[i];
+	}
+
+	return NULL;
+}
+
+PlyReader::PlyReader()
+{
+	mFile   = NULL;
+	mRegion = NULL;
+	mBegin  = NULL;
+	mEnd    = NULL;
+	mBody   = NULL;
+	mFormat = ASCII;
+}
+
+PlyReader::~PlyReader()
+{
+	close();
+}
+
+bool PlyReader::open(const std::string& filepath)
+{
+	close();
+
+	try
+	{
+		mFile   = new file_mapping(filepath.c_str(), read_only);
+		mRegion = new mapped_region(*mFile, read_only);
+	}
+	catch (interprocess_exception&)
+	{
+		close();
+		return false;
+	}
+
+	mBegin = static_cast<const char*>(mRegion->get_address());
+	mEnd   = mBegin + mRegion->get_size();
+
+	if (!parseHeader())
+	{
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+void PlyReader::close()
+{
+	delete mRegion;
+	delete mFile;
+	mRegion = NULL;
+	mFile   = NULL;
+	mBegin  = NULL;
+	mEnd    = NULL;
+	mBody   = NULL;
+	mElements.clear();
+}
+
+PlyReader::Format PlyReader::getFormat() const
+{
+	return mFormat;
+}
+
+const std::vector<PlyReader::Element>& PlyReader::getElements() const
+{
+	return mElements;
+}
+
+const PlyReader::Element* PlyReader::getElement(const std::string& name) const
+{
+	for (unsigned int i=0; i<mElements.size(); ++i)
+	{
+		if (mElements[i].name == name)
+			return &mElements[i];
+	}
+
+	return NULL;
+}
+
+PlyReader::Type PlyReader::getType(const std::string& name)
+{
+	if (name == "char"   || name == "int8")    return INT8;
+	if (name == "uchar"  || name == "uint8")   return UINT8;
+	if (name == "short"  || name == "int16")   return INT16;
+	if (name == "ushort" || name == "uint16")  return UINT16;
+	if (name == "int"    || name == "int32")   return INT32;
+	if (name == "uint"   || name == "uint32")  return UINT32;
+	if (name == "float"  || name == "float32") return FLOAT32;
+	if (name == "double" || name == "float64") return FLOAT64;
+
+	return INVALID;
+}
+
+unsigned int PlyReader::getTypeSize(Type type)
+{
+	switch (type)
+	{
+		case INT8:
+		case UINT8:
+			return 1;
+		case INT16:
+		case UINT16:
+			return 2;
+		case INT32:
+		case UINT32:
+		case FLOAT32:
+			return 4;
+		case FLOAT64:
+			return 8;
+		default:
+			return 0;
+	}
+}
+
+bool PlyReader::parseHeader()
+{
+	const char* data = mBegin;
+	bool isFirstLine = true;
+	while (data < mEnd)
+	{
+		const char* lineEnd = data;
+		while (lineEnd < mEnd && *lineEnd != '\n')
+			lineEnd++;
+		std::string line(data, lineEnd);
+		data = (lineEnd < mEnd) ? lineEnd + 1 : mEnd;
+
+		std::istringstream tokens(line);
+		std::string keyword;
+		tokens >> keyword;
+
+		if (isFirstLine)
+		{
+			if (keyword != "ply")
+				return false;
+			isFirstLine = false;
+		}
+		else if (keyword == "format")
+		{
+			std::string format;
+			tokens >> format;
+			if (format == "ascii")
+				mFormat = ASCII;
+			else if (format == "binary_little_endian")
+				mFormat = BINARY_LITTLE_ENDIAN;
+			else if (format == "binary_big_endian")
+				mFormat = BINARY_BIG_ENDIAN;
+			else
+				return false;
+		}
+		else if (keyword == "element")
+		{
+			Element element;
+			element.count  = 0;
+			element.stride = 0;
+			tokens >> element.name >> element.count;
+			mElements.push_back(element);
+		}
+		else if (keyword == "property")
+		{
+			if (mElements.empty())
+				return false;
+
+			Property property;
+			std::string type;
+			tokens >> type;
+			property.isList    = (type == "list");
+			property.countType = INVALID;
+			property.offset    = 0;
+			if (property.isList)
+			{
+				std::string countType;
+				tokens >> countType >> type;
+				property.countType = getType(countType);
+				if (property.countType == INVALID)
+					return false;
+			}
+			property.type = getType(type);
+			tokens >> property.name;
+			if (property.type == INVALID)
+				return false;
+
+			mElements.back().properties.push_back(property);
+		}
+		else if (keyword == "end_header")
+		{
+			mBody = data;
+			break;
+		}
+		//comment, obj_info: ignored
+	}
+	if (!mBody)
+		return false;
+
+	//binary layout: property offsets are known until the first list property
+	for (unsigned int i=0; i<mElements.size(); ++i)
+	{
+		Element& element = mElements[i];
+		unsigned int offset = 0;
+		bool hasList = false;
+		for (unsigned int j=0; j<element.properties.size() && !hasList; ++j)
+		{
+			hasList = element.properties[j].isList;
+			element.properties[j].offset = offset;
+			offset += getTypeSize(element.properties[j].type);
+		}
+		element.stride = hasList ? 0 : offset;
+	}
+
+	return true;
+}
+
+const char* PlyReader::findElement(const std::string& elementName, const Element*& element) const
+{
+	const char* data = mBody;
+	element = NULL;
+	for (unsigned int i=0; i<mElements.size() && data; ++i)
+	{
+		if (mElements[i].name == elementName)
+		{
+			element = &mElements[i];
+			return data;
+		}
+		data = skipElement(mElements[i], data);
+	}
+
+	return NULL;
+}
+
+bool PlyReader::read(const std::string& elementName, const std::vector<Field>& fields)
+{
+	const Element* element = NULL;
+	const char* data = findElement(elementName, element);
+	if (!data)
+		return false;
+
+	std::vector<Decoder> decoders;
+	for (unsigned int i=0; i<fields.size(); ++i)
+	{
+		for (unsigned int j=0; j<element->properties.size(); ++j)
+		{
+			const Property& property = element->properties[j];
+			if (property.name != fields[i].property || property.isList)
+				continue;
+
+			Decoder decoder;
+			decoder.type            = property.type;
+			decoder.offset          = property.offset;
+			decoder.property        = j;
+			decoder.destination     = fields[i].destination;
+			decoder.destinationType = fields[i].destinationType;
+			decoder.stride          = fields[i].stride;
+			decoder.scale           = fields[i].scale;
+			decoder.isCopy          = (mFormat == BINARY_LITTLE_ENDIAN && property.type == decoder.destinationType && decoder.scale == 1.0f);
+			decoders.push_back(decoder);
+			break;
+		}
+	}
+
+	if (mFormat == ASCII)
+		return readAscii(*element, data, decoders, NULL);
+	else
+		return readBinary(*element, data, decoders, NULL);
+}
+
+bool PlyReader::readList(const std::string& elementName, const std::string& propertyName, std::vector<unsigned int>& counts, std::vector<int>& items)
+{
+	const Element* element = NULL;
+	const char* data = findElement(elementName, element);
+	if (!data)
+		return false;
+
+	ListDecoder list;
+	list.property = (unsigned int) element->properties.size();
+	list.counts   = &counts;
+	list.items    = &items;
+	for (unsigned int j=0; j<element->properties.size(); ++j)
+	{
+		if (element->properties[j].name == propertyName && element->properties[j].isList)
+			list.property = j;
+	}
+	if (list.property == element->properties.size())
+		return false;
+
+	counts.reserve(counts.size() + element->count);
+	std::vector<Decoder> decoders;
+	if (mFormat == ASCII)
+		return readAscii(*element, data, decoders, &list);
+	else
+		return readBinary(*element, data, decoders, &list);
+}
+
+const char* PlyReader::getRecords(const std::string& elementName) const
+{
+	if (mFormat == ASCII)
+		return NULL;
+
+	const Element* element = NULL;
+	const char* data = findElement(elementName, element);
+	if (!data || element->stride == 0 || data + (std::size_t) element->count * element->stride > mEnd)
+		return NULL;
+
+	return data;
+}
+
+const char* PlyReader::skipElement(const Element& element, const char* data) const
+{
+	if (mFormat != ASCII)
+	{
+		if (element.stride > 0)
+			return (data + (std::size_t) element.count * element.stride <= mEnd) ? data + (std::size_t) element.count * element.stride : NULL;
+
+		for (unsigned int i=0; i<element.count && data; ++i)
+			data = skipBinaryRecord(element, data);
+
+		return data;
+	}
+
+	for (unsigned int i=0; i<element.count && data; ++i)
+	{
+		for (unsigned int j=0; j<element.properties.size() && data; ++j)
+		{
+			if (element.properties[j].isList)
+			{
+				double count = 0;
+				data = parseNumber(data, mEnd, count);
+				for (unsigned int k=0; k<(unsigned int) count && data; ++k)
+					data = skipToken(data, mEnd);
+			}
+			else
+				data = skipToken(data, mEnd);
+		}
+	}
+
+	return data;
+}
+
+const char* PlyReader::skipBinaryRecord(const Element& element, const char* data) const
+{
+	for (unsigned int j=0; j<element.properties.size(); ++j)
+	{
+		const Property& property = element.properties[j];
+		if (property.isList)
+		{
+			unsigned int countSize = getTypeSize(property.countType);
+			if (data + countSize > mEnd)
+				return NULL;
+			unsigned int count = (unsigned int) decodeBinary(property.countType, data);
+			data += countSize + (std::size_t) count * getTypeSize(property.type);
+		}
+		else
+			data += getTypeSize(property.type);
+
+		if (data > mEnd)
+			return NULL;
+	}
+
+	return data;
+}
+
+bool PlyReader::readBinary(const Element& element, const char* data, const std::vector<Decoder>& decoders, const ListDecoder* list) const
+{
+	if (element.stride > 0 && !list)
+	{
+		//fixed size records: offsets come from the header
+		if (data + (std::size_t) element.count * element.stride > mEnd)
+			return false;
+
+		for (unsigned int i=0; i<element.count; ++i, data += element.stride)
+		{
+			for (unsigned int k=0; k<decoders.size(); ++k)
+			{
+				const Decoder& decoder = decoders[k];
+				if (decoder.isCopy)
+					memcpy((char*) decoder.destination + i * decoder.stride, data + decoder.offset, 4);
+				else
+					store(decoder, i, decodeBinary(decoder.type, data + decoder.offset));
+			}
+		}
+
+		return true;
+	}
+
+	//records with lists: property offsets are computed for each record
+	std::vector<const char*> properties(element.properties.size());
+	for (unsigned int i=0; i<element.count; ++i)
+	{
+		const char* record = data;
+		for (unsigned int j=0; j<element.properties.size(); ++j)
+		{
+			const Property& property = element.properties[j];
+			properties[j] = record;
+			if (property.isList)
+			{
+				unsigned int countSize = getTypeSize(property.countType);
+				if (record + countSize > mEnd)
+					return false;
+				unsigned int count = (unsigned int) decodeBinary(property.countType, record);
+				record += countSize;
+				const char* items = record;
+				record += (std::size_t) count * getTypeSize(property.type);
+				if (record > mEnd)
+					return false;
+
+				if (list && list->property == j)
+				{
+					list->counts->push_back(count);
+					for (unsigned int k=0; k<count; ++k)
+						list->items->push_back((int) decodeBinary(property.type, items + k * getTypeSize(property.type)));
+				}
+			}
+			else
+				record += getTypeSize(property.type);
+
+			if (record > mEnd)
+				return false;
+		}
+
+		for (unsigned int k=0; k<decoders.size(); ++k)
+			store(decoders[k], i, decodeBinary(decoders[k].type, properties[decoders[k].property]));
+		data = record;
+	}
+
+	return true;
+}
+
+bool PlyReader::readAscii(const Element& element, const char* data, const std::vector<Decoder>& decoders, const ListDecoder* list) const
+{
+	//decoders of each property of the record
+	std::vector<std::vector<const Decoder*> > propertyDecoders(element.properties.size());
+	for (unsigned int k=0; k<decoders.size(); ++k)
+		propertyDecoders[decoders[k].property].push_back(&decoders[k]);
+
+	for (unsigned int i=0; i<element.count; ++i)
+	{
+		for (unsigned int j=0; j<element.properties.size(); ++j)
+		{
+			double value = 0;
+			data = parseNumber(data, mEnd, value);
+			if (!data)
+				return false;
+
+			if (element.properties[j].isList)
+			{
+				unsigned int count = (unsigned int) value;
+				bool isDecoded = (list && list->property == j);
+				if (isDecoded)
+					list->counts->push_back(count);
+				for (unsigned int k=0; k<count && data; ++k)
+				{
+					if (isDecoded)
+					{
+						data = parseNumber(data, mEnd, value);
+						list->items->push_back((int) value);
+					}
+					else
+						data = skipToken(data, mEnd);
+				}
+				if (!data)
+					return false;
+			}
+			else
+			{
+				for (unsigned int k=0; k<propertyDecoders[j].size(); ++k)
+					store(*propertyDecoders[j][k], i, value);
+			}
+		}
+	}
+
+	return true;
+}
+
+double PlyReader::decodeBinary(Type type, const char* data) const
+{
+	unsigned int size = getTypeSize(type);
+	char bytes[8];
+	if (mFormat == BINARY_BIG_ENDIAN)
+	{
+		for (unsigned int i=0; i<size; ++i)
+			bytes[i] = data[size-1-i];
+	}
+	else
+		memcpy(bytes, data, size);
+
+	switch (type)
+	{
+		case INT8:    return *(signed char*) bytes;
+		case UINT8:   return *(unsigned char*) bytes;
+		case INT16:   { short value;          memcpy(&value, bytes, 2); return value; }
+		case UINT16:  { unsigned short value; memcpy(&value, bytes, 2); return value; }
+		case INT32:   { int value;            memcpy(&value, bytes, 4); return value; }
+		case UINT32:  { unsigned int value;   memcpy(&value, bytes, 4); return value; }
+		case FLOAT32: { float value;          memcpy(&value, bytes, 4); return value; }
+		case FLOAT64: { double value;         memcpy(&value, bytes, 8); return value; }
+		default:      return 0;
+	}
+}
+
+const char* PlyReader::parseNumber(const char* data, const char* end, double& value)
+{
+	//locale independent: [-+]digits[.digits][(e|E)[-+]digits]
+	while (data < end && isSpace(*data))
+		data++;
+	if (data == end)
+		return NULL;
+
+	bool negative = false;
+	if (*data == '-' || *data == '+')
+		negative = (*data++ == '-');
+
+	unsigned long long mantissa = 0;
+	int exponent = 0;
+	unsigned int nbDigit = 0;
+	for (; data < end && *data >= '0' && *data <= '9'; ++data, ++nbDigit)
+	{
+		if (mantissa < 100000000000000000ULL)
+			mantissa = mantissa * 10 + (*data - '0');
+		else
+			exponent++;
+	}
+	if (data < end && *data == '.')
+	{
+		for (++data; data < end && *data >= '0' && *data <= '9'; ++data, ++nbDigit)
+		{
+			if (mantissa < 100000000000000000ULL)
+			{
+				mantissa = mantissa * 10 + (*data - '0');
+				exponent--;
+			}
+		}
+	}
+	if (nbDigit == 0)
+	{
+		//nan, inf...: not a number for this reader, skip the token
+		value = 0;
+		return skipToken(data, end);
+	}
+	if (data < end && (*data == 'e' || *data == 'E'))
+	{
+		const char* exponentStart = data++;
+		bool negativeExponent = false;
+		if (data < end && (*data == '-' || *data == '+'))
+			negativeExponent = (*data++ == '-');
+
+		int explicitExponent = 0;
+		bool hasDigit = false;
+		for (; data < end && *data >= '0' && *data <= '9'; ++data, hasDigit = true)
+			explicitExponent = std::min(explicitExponent * 10 + (*data - '0'), 10000);
+
+		if (hasDigit)
+			exponent += negativeExponent ? -explicitExponent : explicitExponent;
+		else
+			data = exponentStart;
+	}
+
+	value = (double) mantissa;
+	while (exponent > 22 && value != 0)
+	{
+		value    *= 1e22;
+		exponent -= 22;
+	}
+	while (exponent < -22 && value != 0)
+	{
+		value    /= 1e22;
+		exponent += 22;
+	}
+	if (value != 0)
+		value = exponent >= 0 ? value * powers[exponent] : value / powers[-exponent];
+	if (negative)
+		value = -value;
+
+	return data;
+}
@@ -0,0 +1,143 @@
+/*
+	Copyright (c) 2010 ASTRE Henri (http://www.visual-experiments.com)
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+	THE SOFTWARE.
+*/
+
+#include "PhotoSynthPlyWriter.h"
+
+#include <algorithm>
+#include <cstdio>
+
+using namespace PhotoSynth;
+
+const std::size_t PlyWriter::defaultBufferSize;
+const std::size_t PlyWriter::binaryVertexSize;
+const std::size_t PlyWriter::maxVertexSize;
+const unsigned int PlyWriter::unknownNbVertex;
+
+PlyWriter::PlyWriter(bool binary, std::size_t bufferSize)
+{
+	mBinary = binary;
+	mBuffer.resize(std::max(bufferSize, maxVertexSize));
+	mSize = 0;
+	mNbVertex = 0;
+	mHeaderNbVertex = unknownNbVertex;
+	mHeaderSize = 0;
+}
+
+PlyWriter::~PlyWriter()
+{
+	//not closed (exception while exporting): the file is incomplete, only an explicit close() creates it
+	if (mOutput.is_open())
+	{
+		mOutput.close();
+		std::remove(mDataFilepath.c_str());
+	}
+}
+
+bool PlyWriter::open(const std::string& filepath, unsigned int nbVertex)
+{
+	close();
+
+	mFilepath       = filepath;
+	mDataFilepath   = filepath + ".tmp";
+	mNbVertex       = 0;
+	mHeaderNbVertex = nbVertex;
+	mHeaderSize     = 0;
+
+	mOutput.open(mDataFilepath.c_str(), std::ios::out | std::ios::binary);
+	if (!mOutput.is_open())
+	{
+		mDataFilepath.clear();
+		return false;
+	}
+
+	if (nbVertex != unknownNbVertex)
+	{
+		writeHeader(mOutput, nbVertex);
+		mHeaderSize = (std::streamoff) mOutput.tellp();
+	}
+
+	return true;
+}
+
+bool PlyWriter::isOpen() const
+{
+	return mOutput.is_open();
+}
+
+void PlyWriter::close()
+{
+	if (!mOutput.is_open())
+		return;
+
+	flush();
+	mOutput.close();
+
+	if (mNbVertex == mHeaderNbVertex)
+	{
+		//header already right: the data file is the ply file
+		std::remove(mFilepath.c_str());
+		std::rename(mDataFilepath.c_str(), mFilepath.c_str());
+	}
+	else
+	{
+		//the vertex count is known now: header then vertices copied from the data file
+		std::ifstream data(mDataFilepath.c_str(), std::ios::in | std::ios::binary);
+		data.seekg(mHeaderSize);
+		std::ofstream output(mFilepath.c_str(), std::ios::out | std::ios::binary);
+		writeHeader(output, mNbVertex);
+		while (data.read(&mBuffer[0], mBuffer.size()) || data.gcount() > 0)
+			output.write(&mBuffer[0], data.gcount());
+		data.close();
+
+		std::remove(mDataFilepath.c_str());
+	}
+	mDataFilepath.clear();
+}
+
+unsigned int PlyWriter::getNbVertex() const
+{
+	return mNbVertex;
+}
+
+void PlyWriter::flush()
+{
+	if (mSize > 0 && mOutput.is_open())
+		mOutput.write(&mBuffer[0], mSize);
+	mSize = 0;
+}
+
+void PlyWriter::writeHeader(std::ostream& output, unsigned int nbVertex) const
+{
+	//header lines end with \n in both formats (PLY readers expect it, \r\n would break binary files)
+	output << "ply\n";
+	output << (mBinary ? "format binary_little_endian 1.0\n" : "format ascii 1.0\n");
+	output << "element vertex " << nbVertex << "\n";
+	output << "property float x\n";
+	output << "property float y\n";
+	output << "property float z\n";
+	output << "property uchar red\n";
+	output << "property uchar green\n";
+	output << "property uchar blue\n";
+	output << "element face 0\n";
+	output << "property list uchar int vertex_indices\n";
+	output << "end_header\n";
+}
@@ -0,0 +1,93 @@
+/*
+	Copyright (c) 2010 ASTRE Henri (http://www.visual-experiments.com)
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+	THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <deque>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+namespace PhotoSynth
+{
+	//Producer/consumer queue: push blocks while the queue is full, pop blocks while it is empty.
+	//Once closed, pop returns false when the queue is empty.
+	template <typename T>
+	class BoundedQueue
+	{
+		public:
+			BoundedQueue(unsigned int capacity)
+			{
+				mCapacity = capacity > 0 ? capacity : 1;
+				mClosed   = false;
+			}
+
+			void push(const T& item)
+			{
+				boost::mutex::scoped_lock lock(mMutex);
+				while (mItems.size() >= mCapacity)
+					mNotFull.wait(lock);
+				mItems.push_back(item);
+				mNotEmpty.notify_one();
+			}
+
+			bool pop(T& item)
+			{
+				boost::mutex::scoped_lock lock(mMutex);
+				while (mItems.empty() && !mClosed)
+					mNotEmpty.wait(lock);
+				if (mItems.empty())
+					return false;
+
+				item = mItems.front();
+				mItems.pop_front();
+				mNotFull.notify_one();
+
+				return true;
+			}
+
+			void close()
+			{
+				boost::mutex::scoped_lock lock(mMutex);
+				mClosed = true;
+				mNotEmpty.notify_all();
+			}
+
+			unsigned int size() const
+			{
+				boost::mutex::scoped_lock lock(mMutex);
+				return (unsigned int) mItems.size();
+			}
+
+			unsigned int capacity() const
+			{
+				return mCapacity;
+			}
+
+		protected:
+			std::deque<T> mItems;
+			unsigned int mCapacity;
+			bool mClosed;
+			mutable boost::mutex mMutex;
+			boost::condition_variable mNotEmpty;
+			boost::condition_variable mNotFull;
+	};
+}
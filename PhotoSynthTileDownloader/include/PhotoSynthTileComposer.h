@@ -0,0 +1,98 @@
+/*
+	Copyright (c) 2010 ASTRE Henri (http://www.visual-experiments.com)
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+	THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <jpeglib.h>
+
+namespace PhotoSynth
+{
+	//Compose a Deep Zoom picture from its jpeg tiles (kept in memory) and stream it to a jpeg file.
+	//A row of tiles maps to a band of 510 output scanlines: tiles are decoded one row at a time
+	//into a band buffer which is written to libjpeg, so memory usage is a single tile row.
+	//Not thread safe: buffers are reused between pictures, use one TileComposer per thread.
+	//
+	//Lossless mode copies DCT coefficients instead of decoding/re-encoding (like jpegtran) when the tiles
+	//are aligned on the MCU grid. With the Deep Zoom 1 pixel overlap, pixels owned by tile k>0 start at
+	//offset 1 in the tile: this never falls on a block boundary, so only single tile pictures qualify,
+	//other pictures fall back to pixel composition.
+	//
+	//Lower resolution pictures (1/2, 1/4, ...) are written at the same time: each output scanline is
+	//box filtered (2x2) into the next level, so no extra pass over the full resolution picture is needed.
+	class TileComposer
+	{
+		public:
+			TileComposer(int quality = 95, bool lossless = false);
+
+			//tiles[j*nbColumn + i] is the jpeg content of the tile at column i and row j
+			//exif (optional) is written as the APP1 segment of the picture
+			//lowerLevelFilePaths[k] (optional) receives the picture downscaled by 2^(k+1)
+			bool compose(const std::string& filepath, unsigned int width, unsigned int height, unsigned int nbColumn, unsigned int nbRow, const std::vector<const std::vector<char>*>& tiles, const std::vector<char>* exif = NULL, const std::vector<std::string>& lowerLevelFilePaths = std::vector<std::string>());
+
+			const std::string& getLastError() const;
+			unsigned int getNbLossless() const;
+
+			static bool isLosslessCompatible(unsigned int nbColumn, unsigned int nbRow);
+
+			//read the APP1 Exif segment (without marker and length) of a jpeg file
+			static bool readExif(const std::string& filepath, std::vector<char>& exif);
+
+			static const unsigned int tileSize = 510; //pixels owned by a tile (without the 1 pixel overlap)
+			static const unsigned int maxLevel = 4;   //full resolution + 3 lower levels
+
+		protected:
+			//output picture at 1/2^k scale
+			struct Level
+			{
+				std::string filepath;
+				bool enabled;
+				FILE* file;
+				bool created;
+				struct jpeg_compress_struct cinfo;
+				unsigned int width;
+				unsigned int height;
+				std::vector<unsigned short> sum; //sum of 2x2 pixels of the previous level
+				std::vector<unsigned char> row;
+				unsigned int nbPendingRow;
+			};
+
+			void pushRow(unsigned int level, unsigned char* row);
+			void emitRow(unsigned int level);
+			void closeLevels(bool removeFiles);
+
+			bool transcodeTile(const std::string& filepath, unsigned int width, unsigned int height, const std::vector<char>& tile, const std::vector<char>* exif);
+			static void writeExif(j_compress_ptr cinfo, const std::vector<char>* exif);
+			bool decodeTile(const std::vector<char>& tile, unsigned int column, unsigned int width, unsigned int bandHeight, unsigned int srcLeft, unsigned int srcTop);
+
+			int mQuality;
+			bool mLossless;
+			unsigned int mNbLossless;
+			std::string mLastError;
+			std::vector<unsigned char> mBand;     //width * tileSize * 3
+			std::vector<unsigned char> mScanline; //tile scanline
+			Level mLevels[maxLevel];
+			unsigned int mNbLevel;
+	};
+}
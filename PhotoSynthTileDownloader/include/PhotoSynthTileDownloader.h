@@ -24,59 +24,101 @@
 
 #include <string>
 #include <vector>
-#include <boost/asio.hpp>
-#include <OgreRoot.h>
 #include <PhotoSynthParser.h>
+#include <PhotoSynthDownloadPolicy.h>
+#include <PhotoSynthDownloadCache.h>
+#include <PhotoSynthConnection.h>
+#include "PhotoSynthTileComposer.h"
+#include "PhotoSynthBoundedQueue.h"
+#include "PhotoSynthTileTelemetry.h"
+#include <boost/shared_ptr.hpp>
 
 namespace PhotoSynth
 {
-	struct TileInfo
-	{	
-		std::string url;
-		std::string filePath;
-		unsigned int i;
-		unsigned int j;
-		unsigned int size;
-	};
-
+	//one picture of the Deep Zoom collection, tile urls are generated on demand from the base url and the grid size
 	struct PictureInfo
 	{
-		std::string url;
-		std::string filePath;
+		std::string getTileUrl(unsigned int i, unsigned int j) const; //column i, row j
+		unsigned int getNbTile() const { return nbColumn * nbRow; }
+
+		std::string url; //base url of the highest level: <url><i>_<j>.jpg
 		unsigned int id;
 		unsigned int width;
 		unsigned int height;		
 		unsigned int nbColumn;
 		unsigned int nbRow;	
 		unsigned int nbLevel;
+	};
+
+	//select which pictures are downloaded, most observed pictures are downloaded first
+	struct PictureFilter
+	{
+		PictureFilter();
 
-		std::vector<TileInfo> tiles;
+		//command line option: coordsystem=<n> top=<k> pictures=<i,j,k-l,...>
+		//throw std::invalid_argument on a reversed range
+		bool parseArgument(const std::string& argument);
+
+		bool contains(unsigned int index) const;
+
+		int coordSystem;   //-1: all coord systems
+		unsigned int top;  //0: all pictures
+		std::vector<std::pair<unsigned int, unsigned int> > ranges; //[first, last] picture indexes, empty: all pictures
+	};
+
+	//compressed tiles of a picture, from a download worker to a composition worker
+	struct ComposeJob
+	{
+		unsigned int pictureIndex;
+		std::vector<std::vector<char> > tiles; //row-major: tiles[j*nbColumn + i]
 	};
+	typedef boost::shared_ptr<ComposeJob> ComposeJobPtr;
 
 	class TileDownloader
 	{
 		public:
-			TileDownloader(boost::asio::io_service* service);
+			TileDownloader(const DownloadPolicy& policy = DownloadPolicy(), DownloadCache* cache = NULL, unsigned int nbDownloadThread = 16, unsigned int nbComposeThread = 4, bool lossless = false, unsigned int nbLowerLevel = 0, unsigned int telemetryInterval = 5);
 			~TileDownloader();
 
-			void download(const std::string& projectFolder);
+			void download(const std::string& projectFolder, const PictureFilter& filter = PictureFilter());
 
 		protected:
 			bool downloadCollection(const std::string& collectionFilePath, const std::string& url);
-			void downloadPicture(unsigned int index);
-			void downloadPictureTile(unsigned int pictureIndex, unsigned int tileIndex);
+			void downloadWorker(BoundedQueue<ComposeJobPtr>& queue);
+			void composeWorker(BoundedQueue<ComposeJobPtr>& queue);
+			void telemetryWorker(const BoundedQueue<ComposeJobPtr>& queue, std::ostream& output);
+			bool downloadPicture(unsigned int index, ComposeJob& job);
+			bool composePicture(TileComposer& composer, const ComposeJob& job);
+			void onPictureDone(unsigned int index);
+			std::string getLevelFilePath(const PictureInfo& info, unsigned int level) const;
+			std::vector<unsigned int> selectPictures(const PictureFilter& filter);
 
 			void parseCollection(const std::string& collectionFilePath);			
+			static size_t countTag(const std::string& xml, const char* tag);
+			static bool isTag(const char* tag, const char* tagEnd, const char* name);
+			static std::string getAttribute(const char* tag, const char* tagEnd, const char* name);
+			static std::string decodeEntities(const char* begin, const char* end);
 			unsigned int getPOT(int value);
 			void clearScreen();
 
 			std::string mProjectPath;
-			Ogre::Root* mRoot;
-			Ogre::Log*  mLog;
-			Ogre::LogManager* mLogManager;
 			PhotoSynth::Parser* mParser;
 			std::string mGuid;
 			std::vector<PictureInfo> mPictures;
-			boost::asio::io_service* mService;
+			DownloadPolicy mPolicy;
+			DownloadReport mReport;
+			DownloadCache* mCache;
+			ConnectionPool mConnectionPool;
+			unsigned int mNbDownloadThread;
+			unsigned int mNbComposeThread;
+			bool mLossless;
+			unsigned int mNbLowerLevel; //hd/level1 (1/2), hd/level2 (1/4), ...
+			unsigned int mNbLossless;
+			TileTelemetry mTelemetry;
+			unsigned int mTelemetryInterval; //s between two progress lines of hd/telemetry.jsonl, 0: summary only
+			std::vector<unsigned int> mPendingPictures;
+			unsigned int mNextPicture;
+			unsigned int mNbPictureDone;
+			boost::mutex mMutex;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,101 @@
+/*
+	Copyright (c) 2010 ASTRE Henri (http://www.visual-experiments.com)
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+	THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <string>
+#include <ostream>
+#include <boost/thread/mutex.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <PhotoSynthConnection.h>
+
+namespace PhotoSynth
+{
+	//Distribution of durations (ms) in power of two buckets: [0,1[ [1,2[ [2,4[ ...
+	//Percentiles are the upper bound of their bucket, good enough to compare runs.
+	class Histogram
+	{
+		public:
+			Histogram();
+
+			void add(double value);
+
+			unsigned int getCount() const;
+			double getMean() const;
+			double getMax() const;
+			double getPercentile(double percent) const;
+
+			void writeJson(std::ostream& output) const;
+
+			static const unsigned int nbBucket = 24; //last bucket: >= 2^22 ms
+
+		protected:
+			unsigned int mBuckets[nbBucket];
+			unsigned int mCount;
+			double mSum;
+			double mMax;
+	};
+
+	//Per stage counters of the tile downloader: network (tiles, bytes, latency, connections),
+	//composition (ms per picture) and the depth of the queue between them.
+	//Snapshots are written as JSON lines, one object per line.
+	class TileTelemetry
+	{
+		public:
+			TileTelemetry();
+
+			void start(unsigned int nbPicture);
+
+			void addTile(std::size_t size, double latency);
+			void addTileFailure();
+			void addPictureDownload(double duration);
+			void addPictureCompose(double duration);
+			void addPictureDone();
+			void sampleQueue(unsigned int depth, unsigned int capacity);
+			void setConnectionStats(const ConnectionStats& stats);
+
+			//event is "progress" for periodic snapshots and "summary" at exit
+			void writeJson(std::ostream& output, const std::string& event);
+			void print(std::ostream& output) const;
+
+		protected:
+			mutable boost::mutex mMutex;
+			boost::posix_time::ptime mStartTime;
+			boost::posix_time::ptime mLastSnapshotTime;
+			unsigned int mNbPicture;
+			unsigned int mNbPictureDone;
+			unsigned int mNbTile;
+			unsigned int mNbTileFailure;
+			unsigned int mLastSnapshotNbTile;
+			boost::uint64_t mNbByte;
+			boost::uint64_t mLastSnapshotNbByte;
+			Histogram mTileLatency;
+			Histogram mPictureDownload;
+			Histogram mPictureCompose;
+			unsigned int mQueueDepth;
+			unsigned int mQueueCapacity;
+			unsigned int mMaxQueueDepth;
+			double mQueueDepthSum;
+			unsigned int mNbQueueSample;
+			ConnectionStats mConnectionStats;
+	};
+}
@@ -0,0 +1,499 @@
+/*
+	Copyright (c) 2010 ASTRE Henri (http://www.visual-experiments.com)
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+	THE SOFTWARE.
+*/
+
+#include "PhotoSynthTileComposer.h"
+
+#include <cstring>
+#include <csetjmp>
+#include <fstream>
+#include <algorithm>
+#include <jerror.h>
+
+using namespace PhotoSynth;
+
+namespace
+{
+	//libjpeg default error handler calls exit(): jump back to the caller instead
+	struct ErrorManager
+	{
+		struct jpeg_error_mgr pub;
+		jmp_buf setjmpBuffer;
+		char message[JMSG_LENGTH_MAX];
+	};
+
+	void onError(j_common_ptr cinfo)
+	{
+		ErrorManager* err = (ErrorManager*) cinfo->err;
+		(*cinfo->err->format_message)(cinfo, err->message);
+		longjmp(err->setjmpBuffer, 1);
+	}
+
+	//jpeg 6b has no memory source (jpeg_mem_src)
+	void initSource(j_decompress_ptr) {}
+	void termSource(j_decompress_ptr) {}
+
+	boolean fillInputBuffer(j_decompress_ptr cinfo)
+	{
+		//truncated data: insert a fake EOI marker as jdatasrc.c does
+		static const JOCTET eoi[2] = { 0xFF, JPEG_EOI };
+		WARNMS(cinfo, JWRN_JPEG_EOF);
+		cinfo->src->next_input_byte = eoi;
+		cinfo->src->bytes_in_buffer = 2;
+
+		return TRUE;
+	}
+
+	void skipInputData(j_decompress_ptr cinfo, long nbBytes)
+	{
+		if (nbBytes <= 0)
+			return;
+
+		if ((size_t) nbBytes > cinfo->src->bytes_in_buffer)
+			fillInputBuffer(cinfo);
+		else
+		{
+			cinfo->src->next_input_byte += nbBytes;
+			cinfo->src->bytes_in_buffer -= nbBytes;
+		}
+	}
+
+	void setMemorySource(j_decompress_ptr cinfo, struct jpeg_source_mgr* src, const std::vector<char>& data)
+	{
+		src->init_source       = initSource;
+		src->fill_input_buffer = fillInputBuffer;
+		src->skip_input_data   = skipInputData;
+		src->resync_to_restart = jpeg_resync_to_restart;
+		src->term_source       = termSource;
+		src->next_input_byte   = (const JOCTET*) &data[0];
+		src->bytes_in_buffer   = data.size();
+		cinfo->src = src;
+	}
+}
+
+const unsigned int TileComposer::tileSize;
+const unsigned int TileComposer::maxLevel;
+
+TileComposer::TileComposer(int quality, bool lossless)
+{
+	mQuality    = quality;
+	mLossless   = lossless;
+	mNbLossless = 0;
+	mNbLevel    = 0;
+}
+
+const std::string& TileComposer::getLastError() const
+{
+	return mLastError;
+}
+
+unsigned int TileComposer::getNbLossless() const
+{
+	return mNbLossless;
+}
+
+bool TileComposer::isLosslessCompatible(unsigned int nbColumn, unsigned int nbRow)
+{
+	return nbColumn == 1 && nbRow == 1;
+}
+
+bool TileComposer::compose(const std::string& filepath, unsigned int width, unsigned int height, unsigned int nbColumn, unsigned int nbRow, const std::vector<const std::vector<char>*>& tiles, const std::vector<char>* exif, const std::vector<std::string>& lowerLevelFilePaths)
+{
+	mLastError.clear();
+	if (width == 0 || height == 0 || tiles.size() != nbColumn*nbRow)
+	{
+		mLastError = "invalid picture dimensions";
+		return false;
+	}
+
+	mNbLevel = 1 + std::min((unsigned int) lowerLevelFilePaths.size(), maxLevel-1);
+
+	bool writeFullLevel = true;
+	if (mLossless && isLosslessCompatible(nbColumn, nbRow) && tiles[0] && !tiles[0]->empty())
+	{
+		if (transcodeTile(filepath, width, height, *tiles[0], exif))
+		{
+			mNbLossless++;
+			if (mNbLevel == 1)
+				return true;
+			writeFullLevel = false; //lower levels still need decoded pixels
+		}
+		mLastError.clear(); //fall back to pixel composition
+	}
+
+	for (unsigned int k=0; k<mNbLevel; ++k)
+	{
+		Level& level       = mLevels[k];
+		level.filepath     = (k == 0) ? filepath : lowerLevelFilePaths[k-1];
+		level.enabled      = (k > 0 || writeFullLevel);
+		level.file         = NULL;
+		level.created      = false;
+		level.width        = (k == 0) ? width  : (mLevels[k-1].width  + 1) / 2;
+		level.height       = (k == 0) ? height : (mLevels[k-1].height + 1) / 2;
+		level.nbPendingRow = 0;
+		level.sum.assign(level.width * 3, 0);
+		level.row.resize(level.width * 3);
+	}
+
+	mBand.resize(width * tileSize * 3);
+
+	ErrorManager jerr;
+	jpeg_std_error(&jerr.pub);
+	jerr.pub.error_exit = onError;
+
+	if (setjmp(jerr.setjmpBuffer))
+	{
+		mLastError = jerr.message;
+		closeLevels(true);
+		return false;
+	}
+
+	for (unsigned int k=0; k<mNbLevel; ++k)
+	{
+		Level& level = mLevels[k];
+		if (!level.enabled)
+			continue;
+
+		level.file = fopen(level.filepath.c_str(), "wb");
+		if (!level.file)
+		{
+			mLastError = "can't open " + level.filepath;
+			closeLevels(true);
+			return false;
+		}
+
+		level.cinfo.err = &jerr.pub;
+		jpeg_create_compress(&level.cinfo);
+		level.created = true;
+		jpeg_stdio_dest(&level.cinfo, level.file);
+
+		level.cinfo.image_width      = level.width;
+		level.cinfo.image_height     = level.height;
+		level.cinfo.input_components = 3;
+		level.cinfo.in_color_space   = JCS_RGB;
+		jpeg_set_defaults(&level.cinfo);
+		jpeg_set_quality(&level.cinfo, mQuality, TRUE);
+		if (exif)
+			level.cinfo.write_JFIF_header = FALSE; //Exif and JFIF headers are exclusive
+
+		jpeg_start_compress(&level.cinfo, TRUE);
+		writeExif(&level.cinfo, exif);
+	}
+
+	bool succeeded = true;
+	for (unsigned int j=0; j<nbRow && succeeded; ++j)
+	{
+		//scanlines [j*510, (j+1)*510[ belong to tile row j
+		unsigned int bandTop    = j * tileSize;
+		unsigned int bandHeight = std::min(tileSize, height - bandTop);
+		unsigned int srcTop     = (j == 0) ? 0 : 1; //skip the overlap with the tile above
+
+		for (unsigned int i=0; i<nbColumn && succeeded; ++i)
+		{
+			const std::vector<char>* tile = tiles[j*nbColumn + i];
+			succeeded = tile && !tile->empty() && decodeTile(*tile, i, width, bandHeight, (i == 0) ? 0 : 1, srcTop);
+		}
+
+		for (unsigned int y=0; y<bandHeight && succeeded; ++y)
+			pushRow(0, &mBand[y * width * 3]);
+	}
+
+	if (succeeded)
+	{
+		//odd height: last row of a level is averaged with itself
+		for (unsigned int k=1; k<mNbLevel; ++k)
+		{
+			if (mLevels[k].nbPendingRow > 0)
+				emitRow(k);
+		}
+
+		for (unsigned int k=0; k<mNbLevel; ++k)
+		{
+			if (mLevels[k].enabled)
+				jpeg_finish_compress(&mLevels[k].cinfo);
+		}
+	}
+	else if (mLastError.empty())
+		mLastError = "missing tile";
+
+	closeLevels(!succeeded);
+
+	return succeeded;
+}
+
+void TileComposer::pushRow(unsigned int level, unsigned char* row)
+{
+	Level& current = mLevels[level];
+	if (current.enabled)
+		jpeg_write_scanlines(&current.cinfo, &row, 1);
+
+	if (level+1 >= mNbLevel)
+		return;
+
+	//2x2 box filter: accumulate horizontal pairs (last column of an odd width is counted twice)
+	Level& next = mLevels[level+1];
+	unsigned short* sum = &next.sum[0];
+	unsigned int lastX = current.width - 1;
+	for (unsigned int x=0; x<next.width; ++x)
+	{
+		const unsigned char* a = &row[(2*x) * 3];
+		const unsigned char* b = &row[std::min(2*x+1, lastX) * 3];
+		sum[3*x+0] += a[0] + b[0];
+		sum[3*x+1] += a[1] + b[1];
+		sum[3*x+2] += a[2] + b[2];
+	}
+
+	if (++next.nbPendingRow == 2)
+		emitRow(level+1);
+}
+
+void TileComposer::emitRow(unsigned int level)
+{
+	Level& current = mLevels[level];
+	unsigned int factor = (current.nbPendingRow == 1) ? 2 : 1;
+
+	for (unsigned int i=0; i<current.row.size(); ++i)
+	{
+		current.row[i] = (unsigned char) ((current.sum[i] * factor + 2) / 4);
+		current.sum[i] = 0;
+	}
+	current.nbPendingRow = 0;
+
+	pushRow(level, &current.row[0]);
+}
+
+void TileComposer::closeLevels(bool removeFiles)
+{
+	for (unsigned int k=0; k<mNbLevel; ++k)
+	{
+		Level& level = mLevels[k];
+		if (level.created)
+			jpeg_destroy_compress(&level.cinfo);
+		if (level.file)
+		{
+			fclose(level.file);
+			if (removeFiles)
+				remove(level.filepath.c_str());
+		}
+		level.created = false;
+		level.file    = NULL;
+	}
+}
+
+bool TileComposer::transcodeTile(const std::string& filepath, unsigned int width, unsigned int height, const std::vector<char>& tile, const std::vector<char>* exif)
+{
+	struct jpeg_decompress_struct srcinfo;
+	struct jpeg_compress_struct dstinfo;
+	struct jpeg_source_mgr src;
+	ErrorManager jerr;
+	srcinfo.err = jpeg_std_error(&jerr.pub);
+	dstinfo.err = srcinfo.err;
+	jerr.pub.error_exit = onError;
+
+	jpeg_create_decompress(&srcinfo);
+	jpeg_create_compress(&dstinfo);
+
+	FILE* outfile = fopen(filepath.c_str(), "wb");
+	if (!outfile)
+	{
+		jpeg_destroy_compress(&dstinfo);
+		jpeg_destroy_decompress(&srcinfo);
+		mLastError = "can't open " + filepath;
+		return false;
+	}
+
+	if (setjmp(jerr.setjmpBuffer))
+	{
+		mLastError = jerr.message;
+		jpeg_destroy_compress(&dstinfo);
+		jpeg_destroy_decompress(&srcinfo);
+		fclose(outfile);
+		remove(filepath.c_str());
+		return false;
+	}
+
+	setMemorySource(&srcinfo, &src, tile);
+	jpeg_read_header(&srcinfo, TRUE);
+
+	bool aligned = (srcinfo.image_width == width && srcinfo.image_height == height);
+	if (aligned)
+	{
+		//coefficients are copied as is: no decoding, no second generation loss
+		jvirt_barray_ptr* coefficients = jpeg_read_coefficients(&srcinfo);
+
+		jpeg_stdio_dest(&dstinfo, outfile);
+		jpeg_copy_critical_parameters(&srcinfo, &dstinfo);
+		if (exif)
+			dstinfo.write_JFIF_header = FALSE;
+		jpeg_write_coefficients(&dstinfo, coefficients);
+		writeExif(&dstinfo, exif);
+
+		jpeg_finish_compress(&dstinfo);
+		jpeg_finish_decompress(&srcinfo);
+	}
+
+	jpeg_destroy_compress(&dstinfo);
+	jpeg_destroy_decompress(&srcinfo);
+	fclose(outfile);
+
+	if (!aligned)
+	{
+		mLastError = "tile doesn't match picture dimensions";
+		remove(filepath.c_str());
+	}
+
+	return aligned;
+}
+
+bool TileComposer::readExif(const std::string& filepath, std::vector<char>& exif)
+{
+	exif.clear();
+
+	std::ifstream input(filepath.c_str(), std::ios::binary);
+	if (!input.is_open())
+		return false;
+
+	unsigned char marker[2];
+	input.read((char*) marker, 2);
+	if (!input || marker[0] != 0xFF || marker[1] != 0xD8) //SOI
+		return false;
+
+	//walk the segments until the image data
+	while (input.read((char*) marker, 2))
+	{
+		if (marker[0] != 0xFF)
+			return false;
+		if (marker[1] == 0xFF) //fill byte
+		{
+			input.seekg(-1, std::ios::cur);
+			continue;
+		}
+		if (marker[1] == 0xDA || marker[1] == 0xD9) //SOS, EOI
+			return false;
+
+		unsigned char length[2];
+		if (!input.read((char*) length, 2))
+			return false;
+		unsigned int size = (length[0] << 8) | length[1];
+		if (size < 2)
+			return false;
+		size -= 2;
+
+		if (marker[1] == 0xE1) //APP1
+		{
+			std::vector<char> segment(size);
+			if (size > 0 && !input.read(&segment[0], size))
+				return false;
+			if (size >= 6 && memcmp(&segment[0], "Exif\0\0", 6) == 0)
+			{
+				exif.swap(segment);
+				return true;
+			}
+		}
+		else
+			input.seekg(size, std::ios::cur);
+	}
+
+	return false;
+}
+
+void TileComposer::writeExif(j_compress_ptr cinfo, const std::vector<char>* exif)
+{
+	//must be called right after jpeg_start_compress / jpeg_write_coefficients
+	if (exif && !exif->empty() && exif->size() <= 65533)
+		jpeg_write_marker(cinfo, JPEG_APP0 + 1, (const JOCTET*) &(*exif)[0], (unsigned int) exif->size());
+}
+
+bool TileComposer::decodeTile(const std::vector<char>& tile, unsigned int column, unsigned int width, unsigned int bandHeight, unsigned int srcLeft, unsigned int srcTop)
+{
+	struct jpeg_decompress_struct cinfo;
+	struct jpeg_source_mgr src;
+	ErrorManager jerr;
+	cinfo.err = jpeg_std_error(&jerr.pub);
+	jerr.pub.error_exit = onError;
+
+	if (setjmp(jerr.setjmpBuffer))
+	{
+		mLastError = jerr.message;
+		jpeg_destroy_decompress(&cinfo);
+		return false;
+	}
+
+	jpeg_create_decompress(&cinfo);
+	setMemorySource(&cinfo, &src, tile);
+	jpeg_read_header(&cinfo, TRUE);
+	jpeg_start_decompress(&cinfo);
+
+	unsigned int n = cinfo.output_components;
+	if (n != 1 && n != 3)
+	{
+		jpeg_destroy_decompress(&cinfo);
+		mLastError = "unsupported tile color space";
+		return false;
+	}
+
+	mScanline.resize(cinfo.output_width * n);
+
+	//pixels owned by this tile: [column*510, column*510 + 510[ clipped to the picture and the tile
+	unsigned int left        = column * tileSize;
+	unsigned int ownedWidth  = std::min(tileSize, width - left);
+	unsigned int ownedHeight = bandHeight;
+	if (srcLeft + ownedWidth > cinfo.output_width)
+		ownedWidth = cinfo.output_width > srcLeft ? cinfo.output_width - srcLeft : 0;
+	if (srcTop + ownedHeight > cinfo.output_height)
+		ownedHeight = cinfo.output_height > srcTop ? cinfo.output_height - srcTop : 0;
+
+	unsigned int y = 0;
+	while (cinfo.output_scanline < srcTop + ownedHeight)
+	{
+		JSAMPROW row = &mScanline[0];
+		jpeg_read_scanlines(&cinfo, &row, 1);
+		if (y++ < srcTop)
+			continue;
+
+		unsigned char* dst = &mBand[((y-1-srcTop) * width + left) * 3];
+		const unsigned char* src = &mScanline[srcLeft * n];
+		if (n == 3)
+			memcpy(dst, src, ownedWidth * 3);
+		else
+		{
+			for (unsigned int x=0; x<ownedWidth; ++x)
+			{
+				dst[3*x+0] = src[x];
+				dst[3*x+1] = src[x];
+				dst[3*x+2] = src[x];
+			}
+		}
+	}
+
+	//the bottom overlap row isn't needed
+	jpeg_abort_decompress(&cinfo);
+	jpeg_destroy_decompress(&cinfo);
+
+	//a tile smaller than expected would leave uninitialized pixels
+	if (ownedWidth < std::min(tileSize, width - left) || ownedHeight < bandHeight)
+	{
+		mLastError = "tile smaller than expected";
+		return false;
+	}
+
+	return true;
+}
@@ -23,39 +23,102 @@
 #include "PhotoSynthTileDownloader.h"
 
 #include <PhotoSynthDownloadHelper.h>
+#include <PhotoSynthBinFileReader.h>
 #include <boost/filesystem/operations.hpp>
-#include <boost/threadpool.hpp>
-#include <OgreRoot.h>
-#include <OgreCodec.h>
-#include <tinyxml.h>
-#include <CanvasTexture.h>
+#include <boost/thread/thread.hpp>
+#include <boost/bind.hpp>
+#include <boost/algorithm/string.hpp>
+#include <fstream>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <stdexcept>
+#include <map>
+#include <set>
+#include <algorithm>
 
 using namespace PhotoSynth;
 namespace bf = boost::filesystem;
 
-TileDownloader::TileDownloader(boost::asio::io_service* service)
+TileDownloader::TileDownloader(const DownloadPolicy& policy, DownloadCache* cache, unsigned int nbDownloadThread, unsigned int nbComposeThread, bool lossless, unsigned int nbLowerLevel, unsigned int telemetryInterval)
+: mConnectionPool(std::max(nbDownloadThread, 1u))
 {
-	mService = service;
+	mPolicy           = policy;
+	mCache            = cache;
+	mNbDownloadThread = std::max(nbDownloadThread, 1u);
+	mNbComposeThread  = std::max(nbComposeThread, 1u);
+	mLossless         = lossless;
+	mNbLowerLevel     = std::min(nbLowerLevel, TileComposer::maxLevel-1);
+	mNbLossless       = 0;
+	mTelemetryInterval = telemetryInterval;
+	mNextPicture      = 0;
+	mNbPictureDone    = 0;
 	mParser = new PhotoSynth::Parser;
 
-	mLogManager = new Ogre::LogManager();
-	mLog  = mLogManager->createLog("Ogre.log", false, false);
-	mRoot = new Ogre::Root("plugins.cfg", "ogre.cfg");
-	Ogre::LogManager::getSingleton().getDefaultLog()->setDebugOutputEnabled(false);
+	//no Ogre::Root: tiles are decoded and pictures encoded by libjpeg directly (see TileComposer)
 }
 
 TileDownloader::~TileDownloader()
 {
 	delete mParser;
+}
 
-	mRoot->shutdown();
-	delete mRoot;
-	mRoot = NULL;
-	mLogManager->destroyLog(mLog);
-	delete mLogManager;
+PictureFilter::PictureFilter()
+{
+	coordSystem = -1;
+	top         = 0;
 }
 
-void TileDownloader::download(const std::string& projectFolder)
+bool PictureFilter::parseArgument(const std::string& argument)
+{
+	std::string::size_type separator = argument.find('=');
+	if (separator == std::string::npos)
+		return false;
+
+	std::string name  = argument.substr(0, separator);
+	std::string value = argument.substr(separator+1);
+
+	if (name == "coordsystem")
+		coordSystem = atoi(value.c_str());
+	else if (name == "top")
+		top = (unsigned int) atoi(value.c_str());
+	else if (name == "pictures")
+	{
+		//comma separated indexes or ranges: 0,4,10-20
+		std::vector<std::string> items;
+		boost::algorithm::split(items, value, boost::algorithm::is_any_of(","), boost::algorithm::token_compress_on);
+		for (unsigned int i=0; i<items.size(); ++i)
+		{
+			std::string::size_type dash = items[i].find('-');
+			unsigned int first = (unsigned int) atoi(items[i].substr(0, dash).c_str());
+			unsigned int last  = (dash == std::string::npos) ? first : (unsigned int) atoi(items[i].substr(dash+1).c_str());
+			if (first > last)
+				throw std::invalid_argument("invalid picture range: " + items[i]);
+
+			//ranges are kept as is: pictures=0-4000000000 doesn't expand to billions of indexes
+			ranges.push_back(std::make_pair(first, last));
+		}
+	}
+	else
+		return false;
+
+	return true;
+}
+
+bool PictureFilter::contains(unsigned int index) const
+{
+	if (ranges.empty())
+		return true;
+
+	for (unsigned int i=0; i<ranges.size(); ++i)
+	{
+		if (index >= ranges[i].first && index <= ranges[i].second)
+			return true;
+	}
+	return false;
+}
+
+void TileDownloader::download(const std::string& projectFolder, const PictureFilter& filter)
 {
 	mProjectPath = projectFolder;
 
@@ -70,11 +133,13 @@ void TileDownloader::download(const std::string& projectFolder)
 	if (!bf::exists(path.str()))
 		bf::create_directory(path.str());
 
-	path.str("");
-	path << projectFolder << "hd/tmp";
-	if (!bf::exists(path.str()))
-		bf::create_directory(path.str());
-	Ogre::ResourceGroupManager::getSingleton().addResourceLocation(path.str(), "FileSystem", Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME);
+	for (unsigned int k=1; k<=mNbLowerLevel; ++k)
+	{
+		path.str("");
+		path << projectFolder << "hd/level" << k;
+		if (!bf::exists(path.str()))
+			bf::create_directory(path.str());
+	}
 
 	std::stringstream guidPath;
 	guidPath << projectFolder << "guid.txt";
@@ -108,213 +173,442 @@ void TileDownloader::download(const std::string& projectFolder)
 	std::cout << "[" << mParser->getNbCamera(0) << " cameras found in Synth " << mGuid << "]" << std::endl;
 	std::cout << "[Downloading Synth Collection information...]";
 	std::string collectionFilePath = Parser::createFilePath(projectFolder, "collection.xml");
-	if (!bf::exists(collectionFilePath))
-		downloadCollection(collectionFilePath, mParser->getSoapInfo().dzcUrl);
+	if (!bf::exists(collectionFilePath) && !downloadCollection(collectionFilePath, mParser->getSoapInfo().dzcUrl))
+	{
+		clearScreen();
+		mReport.print(std::cout);
+		return;
+	}
 
 	parseCollection(collectionFilePath);
 	clearScreen();
 	std::cout << "[Synth Collection Downloaded]" << std::endl;
 
-	
-	for (unsigned int i=0; i<mPictures.size(); ++i)
+	std::vector<unsigned int> selection = selectPictures(filter);
+	std::cout << "[" << selection.size() << "/" << mPictures.size() << " pictures selected]" << std::endl;
+
+	mPendingPictures.clear();
+	for (unsigned int i=0; i<selection.size(); ++i)
 	{
-		int percent = (int)(((i+1)*100.0f) / (1.0f*mPictures.size()));
-		if (!bf::exists(mPictures[i].filePath))
-			downloadPicture(i);
-		clearScreen();
-		std::cout << "[Downloading picture : " << percent << "%] - ("<<i+1<<"/"<<mPictures.size()<<" "<< mPictures[i].width <<" x " << mPictures[i].height << ")";
+		const PictureInfo& info = mPictures[selection[i]];
+		bool done = bf::exists(getLevelFilePath(info, 0));
+		for (unsigned int k=1; k<=mNbLowerLevel && done; ++k)
+			done = bf::exists(getLevelFilePath(info, k));
+		if (!done)
+			mPendingPictures.push_back(selection[i]);
 	}
+	mNextPicture   = 0;
+	mNbPictureDone = 0;
+	mNbLossless    = 0;
+	mTelemetry.start((unsigned int) mPendingPictures.size());
+
+	std::ofstream telemetryOutput(Parser::createFilePath(projectFolder, "hd/telemetry.jsonl").c_str(), std::ios::out | std::ios::app);
+
+	//network workers download the tiles of one picture each and feed the composition workers
+	{
+		BoundedQueue<ComposeJobPtr> queue(2 * mNbComposeThread);
+
+		boost::thread_group composeThreads;
+		for (unsigned int i=0; i<mNbComposeThread; ++i)
+			composeThreads.create_thread(boost::bind(&TileDownloader::composeWorker, this, boost::ref(queue)));
+
+		boost::thread_group downloadThreads;
+		for (unsigned int i=0; i<mNbDownloadThread; ++i)
+			downloadThreads.create_thread(boost::bind(&TileDownloader::downloadWorker, this, boost::ref(queue)));
+
+		boost::thread telemetryThread(boost::bind(&TileDownloader::telemetryWorker, this, boost::cref(queue), boost::ref(telemetryOutput)));
+
+		downloadThreads.join_all();
+		queue.close();
+		composeThreads.join_all();
+
+		telemetryThread.interrupt();
+		telemetryThread.join();
+	}
+	mTelemetry.setConnectionStats(mConnectionPool.getStats());
+	mTelemetry.writeJson(telemetryOutput, "summary");
+
 	clearScreen();
 	std::cout << "[Picture downloaded]" << std::endl;
+	if (mLossless)
+		std::cout << mNbLossless << " pictures stitched losslessly, others were re-encoded" << std::endl;
+	mReport.print(std::cout);
+	mTelemetry.print(std::cout);
+	if (mCache)
+		mCache->print(std::cout);
+	if (mReport.getNbFailure() > 0)
+		mReport.save(Parser::createFilePath(projectFolder, "hd/download_failures.txt"));
+}
 
-	path.str("");
-	path << projectFolder << "thumbs/00000000.jpg";
-	if (bf::exists(path.str())) //test if thumbs are available
+void TileDownloader::downloadWorker(BoundedQueue<ComposeJobPtr>& queue)
+{
+	while (true)
 	{
-		for (unsigned int i=0; i<mPictures.size(); ++i)
+		ComposeJobPtr job(new ComposeJob);
 		{
-			std::stringstream paddedIndex;
-			paddedIndex.width(8);
-			paddedIndex.fill('0');
-			paddedIndex << i;
-
-			std::stringstream thumbPath;			
-			thumbPath << projectFolder << "thumbs/" << paddedIndex.str() << ".jpg";
-			
-			std::stringstream hdPath;
-			hdPath << projectFolder << "hd/" << paddedIndex.str() << ".jpg";
-
-			std::stringstream command;
-			command << "jhead -te " << thumbPath.str() << " " << hdPath.str();
-
-			if (bf::exists(thumbPath.str()) && bf::exists(hdPath.str()))
-				system(command.str().c_str());
+			boost::mutex::scoped_lock lock(mMutex);
+			if (mNextPicture >= mPendingPictures.size())
+				return;
+			job->pictureIndex = mPendingPictures[mNextPicture++];
 		}
+
+		if (downloadPicture(job->pictureIndex, *job))
+			queue.push(job); //wait while all composition workers are busy
+		else
+			onPictureDone(job->pictureIndex);
 	}
+}
+
+void TileDownloader::composeWorker(BoundedQueue<ComposeJobPtr>& queue)
+{
+	//buffers are reused for all the pictures composed by this worker
+	TileComposer composer(95, mLossless);
+
+	ComposeJobPtr job;
+	while (queue.pop(job))
+	{
+		boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+		composePicture(composer, *job);
+		mTelemetry.addPictureCompose((double) (boost::posix_time::microsec_clock::universal_time() - start).total_microseconds() / 1000.0);
+
+		onPictureDone(job->pictureIndex);
+		job.reset();
+	}
+
+	boost::mutex::scoped_lock lock(mMutex);
+	mNbLossless += composer.getNbLossless();
+}
 
-	path.str("");
-	path << projectFolder << "hd/tmp";
-	bf::remove_all(path.str());
+void TileDownloader::telemetryWorker(const BoundedQueue<ComposeJobPtr>& queue, std::ostream& output)
+{
+	//queue depth is sampled every 100 ms, a progress line is written every mTelemetryInterval s
+	const unsigned int samplePeriod = 100;
+	unsigned int elapsed = 0;
+	try
+	{
+		while (true)
+		{
+			boost::this_thread::sleep(boost::posix_time::milliseconds(samplePeriod));
+			mTelemetry.sampleQueue(queue.size(), queue.capacity());
+
+			elapsed += samplePeriod;
+			if (mTelemetryInterval > 0 && elapsed >= mTelemetryInterval*1000)
+			{
+				elapsed = 0;
+				mTelemetry.setConnectionStats(mConnectionPool.getStats());
+				mTelemetry.writeJson(output, "progress");
+			}
+		}
+	}
+	catch (boost::thread_interrupted&)
+	{
+		//download is over, the summary is written by download()
+	}
 }
 
-void TileDownloader::downloadPicture(unsigned int index)
+bool TileDownloader::downloadPicture(unsigned int index, ComposeJob& job)
 {
 	const PictureInfo& info = mPictures[index];
-	
-	//Downloading all tiles in parallel
+
+	//tiles of a picture are downloaded one after the other on a keep-alive connection (compressed tiles are kept in memory)
+	boost::posix_time::ptime pictureStart = boost::posix_time::microsec_clock::universal_time();
+
+	job.tiles.resize(info.getNbTile());
+	for (unsigned int j=0; j<info.nbRow; ++j)
 	{
-		boost::threadpool::pool tp(info.tiles.size());
-		for (unsigned int i=0; i<info.tiles.size(); ++i)
-			tp.schedule(boost::bind(&TileDownloader::downloadPictureTile, this, index, i));
+		for (unsigned int i=0; i<info.nbColumn; ++i)
+		{
+			std::vector<char>& tile = job.tiles[j*info.nbColumn + i];
+
+			boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+			if (!DownloadHelper::fetchBuffer(info.getTileUrl(i, j), tile, mPolicy, &mReport, &mConnectionPool, mCache) || tile.empty())
+			{
+				mTelemetry.addTileFailure();
+				return false; //don't compose a picture with missing tiles (failures are in mReport, next run will retry)
+			}
+			mTelemetry.addTile(tile.size(), (double) (boost::posix_time::microsec_clock::universal_time() - start).total_microseconds() / 1000.0);
+		}
 	}
-	//compose all tiles on the canvas
-	unsigned int width  = info.width;
-	unsigned int height = info.height;
-	Ogre::Canvas::Context* ctx = new Ogre::Canvas::Context(width, height, false);
-	for (unsigned int i=0; i<info.tiles.size(); ++i)
+	mTelemetry.addPictureDownload((double) (boost::posix_time::microsec_clock::universal_time() - pictureStart).total_microseconds() / 1000.0);
+
+	return true;
+}
+
+bool TileDownloader::composePicture(TileComposer& composer, const ComposeJob& job)
+{
+	const PictureInfo& info = mPictures[job.pictureIndex];
+
+	std::vector<const std::vector<char>*> tiles(job.tiles.size());
+	for (unsigned int i=0; i<job.tiles.size(); ++i)
+		tiles[i] = &job.tiles[i];
+
+	//copy Exif data from the thumb (if thumbs have been downloaded) while the picture is written
+	std::stringstream thumbPath;
+	thumbPath << mProjectPath << "thumbs/";
+	thumbPath.width(8);
+	thumbPath.fill('0');
+	thumbPath << info.id << ".jpg";
+
+	std::vector<char> exif;
+	bool hasExif = TileComposer::readExif(thumbPath.str(), exif);
+
+	std::vector<std::string> lowerLevelFilePaths;
+	for (unsigned int k=1; k<=mNbLowerLevel; ++k)
+		lowerLevelFilePaths.push_back(getLevelFilePath(info, k));
+
+	//decode one row of tiles at a time and stream its scanlines to the jpeg file (and its lower levels)
+	std::string filePath = getLevelFilePath(info, 0);
+	if (!composer.compose(filePath, info.width, info.height, info.nbColumn, info.nbRow, tiles, hasExif ? &exif : NULL, lowerLevelFilePaths))
 	{
-		const TileInfo& tileInfo = info.tiles[i];
-		Ogre::Image img;
-		std::stringstream filename;
-		filename << tileInfo.j << "_" << tileInfo.i << ".jpg";
-		img.load(filename.str(), Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME);		
-		float x = (tileInfo.i == 0) ? 0 : 509.0f + (tileInfo.i-1)*510.0f;
-		float y = (tileInfo.j == 0) ? 0 : 509.0f + (tileInfo.j-1)*510.0f;
-		ctx->drawImage(img, x, y);
+		mReport.addFailure(filePath, composer.getLastError(), 1);
+		return false;
 	}
-	
-	//save canvas to jpeg
-	ctx->saveToFile(info.filePath);
 
-	delete ctx;
+	return true;
 }
 
-void TileDownloader::downloadPictureTile(unsigned int pictureIndex, unsigned int tileIndex)
+std::vector<unsigned int> TileDownloader::selectPictures(const PictureFilter& filter)
 {
-	TileInfo& tileInfo = mPictures[pictureIndex].tiles[tileIndex];
-	std::string url      = tileInfo.url;
-	std::string filepath = tileInfo.filePath;
+	//observations per image: number of points seen by each image in the bin files (if downloaded)
+	std::map<unsigned int, unsigned int> nbObservation;
+	std::set<unsigned int> inCoordSystem;
 
-	std::string host = DownloadHelper::extractHost(url);
-	SocketPtr sock = DownloadHelper::connect(mService, host);
+	std::stringstream binPath;
+	binPath << mProjectPath << "bin";
+	bool hasBinFiles = bf::exists(binPath.str());
+	if (!hasBinFiles && filter.top > 0)
+		std::cout << binPath.str() << " not found: pictures can't be sorted by observations" << std::endl;
 
-	std::string header = DownloadHelper::createGETHeader(DownloadHelper::removeHost(url, host), host);
+	for (unsigned int i=0; i<mParser->getNbCoordSystem(); ++i)
+	{
+		if (filter.coordSystem >= 0 && (unsigned int) filter.coordSystem != i)
+			continue;
 
-	//send GET request
-	boost::system::error_code error;
-	boost::asio::write(*sock, boost::asio::buffer(header.c_str()), boost::asio::transfer_all(), error);
+		for (unsigned int j=0; j<mParser->getNbCamera(i); ++j)
+			inCoordSystem.insert((unsigned int) mParser->getCamera(i, j).index);
 
-	//read the response (header + content)
-	boost::asio::streambuf response;
-	while (boost::asio::read(*sock, response, boost::asio::transfer_at_least(1), error));
+		if (!hasBinFiles)
+			continue;
 
-	std::istream response_stream(&response);
-	int length = DownloadHelper::getContentLength(response_stream);
-	tileInfo.size = (unsigned int) length;
+		//only the observations are read from each bin file, not the vertices (huge synths don't fit in memory)
+		//infos[k] belongs to camera k of this coord system: count it for the picture of that camera
+		BinFileReader reader;
+		for (unsigned int j=0; j<mParser->getNbPointCloud(i); ++j)
+		{
+			std::vector<std::vector<VertexInfo> > infos;
+			if (!reader.open(BinFileReader::getFilePath(mProjectPath, i, j), &infos))
+				continue;
 
-	DownloadHelper::saveBinFile(filepath, response_stream, length);			
+			unsigned int nbCamera = std::min((unsigned int) infos.size(), mParser->getNbCamera(i));
+			for (unsigned int k=0; k<nbCamera; ++k)
+				nbObservation[(unsigned int) mParser->getCamera(i, k).index] += infos[k].size();
+		}
+	}
 
-	sock->close();
+	//(observations, picture index) sorted by decreasing observations, then by index
+	std::vector<std::pair<int, unsigned int> > selection;
+	for (unsigned int i=0; i<mPictures.size(); ++i)
+	{
+		unsigned int id = mPictures[i].id;
+		if (filter.coordSystem >= 0 && inCoordSystem.find(id) == inCoordSystem.end())
+			continue;
+		if (!filter.contains(id))
+			continue;
+
+		selection.push_back(std::make_pair(-(int) nbObservation[id], i));
+	}
+	std::sort(selection.begin(), selection.end());
+
+	if (filter.top > 0 && selection.size() > filter.top)
+		selection.resize(filter.top);
+
+	std::vector<unsigned int> pictures;
+	for (unsigned int i=0; i<selection.size(); ++i)
+		pictures.push_back(selection[i].second);
+
+	return pictures;
+}
+
+std::string TileDownloader::getLevelFilePath(const PictureInfo& info, unsigned int level) const
+{
+	std::stringstream filePath;
+	filePath << mProjectPath << "hd/";
+	if (level > 0)
+		filePath << "level" << level << "/";
+	filePath.width(8);
+	filePath.fill('0');
+	filePath << info.id << ".jpg";
+
+	return filePath.str();
+}
+
+void TileDownloader::onPictureDone(unsigned int index)
+{
+	boost::mutex::scoped_lock lock(mMutex);
+
+	mNbPictureDone++;
+	mTelemetry.addPictureDone();
+	int percent = (int)((mNbPictureDone*100.0f) / (1.0f*mPendingPictures.size()));
+	clearScreen();
+	std::cout << "[Downloading picture : " << percent << "%] - ("<<mNbPictureDone<<"/"<<mPendingPictures.size()<<" "<< mPictures[index].width <<" x " << mPictures[index].height << ")";
 }
 
 bool TileDownloader::downloadCollection(const std::string& collectionFilePath, const std::string& collectionUrl)
 {
-	try
+	return DownloadHelper::fetchFile(collectionUrl, collectionFilePath, mPolicy, &mReport, NULL, mCache);
+}
+
+void TileDownloader::parseCollection(const std::string& collectionFilePath)
+{
+	//collection.xml can hold thousands of pictures: read it in one go and scan the tags instead of building a DOM
+	std::string xml;
 	{
-		std::string host = DownloadHelper::extractHost(collectionUrl);
-		SocketPtr sock = DownloadHelper::connect(mService, host);
+		std::ifstream input(collectionFilePath.c_str(), std::ios::in | std::ios::binary);
+		if (!input.is_open())
+			return;
+		input.seekg(0, std::ios::end);
+		xml.resize((size_t) std::max((std::streamoff) input.tellg(), (std::streamoff) 0));
+		input.seekg(0, std::ios::beg);
+		if (!xml.empty())
+			input.read(&xml[0], xml.size());
+	}
 
-		std::string header = DownloadHelper::createGETHeader(DownloadHelper::removeHost(collectionUrl, host), host);
+	mPictures.clear();
+	mPictures.reserve(countTag(xml, "<I "));
 
-		//send GET request
-		boost::system::error_code error;
-		boost::asio::write(*sock, boost::asio::buffer(header.c_str()), boost::asio::transfer_all(), error);
+	std::string source;
+	PictureInfo pictureInfo;
+	bool inPicture = false;
 
-		//read the response (header + content)
-		boost::asio::streambuf response;
-		while (boost::asio::read(*sock, response, boost::asio::transfer_at_least(1), error));
+	size_t pos = 0;
+	while ((pos = xml.find('<', pos)) != std::string::npos)
+	{
+		if (xml.compare(pos, 4, "<!--") == 0)
+		{
+			pos = xml.find("-->", pos);
+			continue;
+		}
+		size_t end = xml.find('>', pos);
+		if (end == std::string::npos)
+			break;
+
+		const char* tag    = xml.c_str() + pos + 1;
+		const char* tagEnd = xml.c_str() + end;
+		pos = end + 1;
 
-		sock->close();
+		if (isTag(tag, tagEnd, "I"))
+		{
+			inPicture = true;
+			source    = getAttribute(tag, tagEnd, "Source");
+			pictureInfo.id     = atoi(getAttribute(tag, tagEnd, "Id").c_str());
+			pictureInfo.width  = 0;
+			pictureInfo.height = 0;
+		}
+		else if (inPicture && isTag(tag, tagEnd, "Size"))
+		{
+			pictureInfo.width  = atoi(getAttribute(tag, tagEnd, "Width").c_str());
+			pictureInfo.height = atoi(getAttribute(tag, tagEnd, "Height").c_str());
+		}
+		else if (inPicture && isTag(tag, tagEnd, "/I"))
+		{
+			inPicture = false;
 
-		//skip header from response
-		std::istream response_stream(&response);
-		std::string line;
-		while (std::getline(response_stream, line) && line != "\r");
+			pictureInfo.nbColumn = (pictureInfo.width  + 509) / 510;
+			pictureInfo.nbRow    = (pictureInfo.height + 509) / 510;
+			pictureInfo.nbLevel  = getPOT(std::max(pictureInfo.width, pictureInfo.height));
 
-		//put collection into collectionText
-		std::stringstream collectionText;
-		while (std::getline(response_stream, line))
-			collectionText << line << std::endl;
+			std::stringstream replacement;
+			replacement << "_files/" << pictureInfo.nbLevel << "/";
+			pictureInfo.url = boost::algorithm::replace_all_copy(source, ".dzi", replacement.str());
 
-		//save collection
-		if (!DownloadHelper::saveAsciiFile(collectionFilePath, collectionText.str()))
-			return false;
+			mPictures.push_back(pictureInfo);
+		}
 	}
-	catch (std::exception& e)
-	{		
-		std::cout << e.what() << std::endl;
+}
+
+size_t TileDownloader::countTag(const std::string& xml, const char* tag)
+{
+	size_t count = 0;
+	for (size_t pos = xml.find(tag); pos != std::string::npos; pos = xml.find(tag, pos+1))
+		count++;
+
+	return count;
+}
+
+bool TileDownloader::isTag(const char* tag, const char* tagEnd, const char* name)
+{
+	size_t length = strlen(name);
+	if ((size_t)(tagEnd - tag) < length || strncmp(tag, name, length) != 0)
 		return false;
-	}
-	return true;
+
+	char next = tag[length];
+	return tag + length == tagEnd || next == ' ' || next == '\t' || next == '\r' || next == '\n' || next == '/';
 }
 
-void TileDownloader::parseCollection(const std::string& collectionFilePath)
+std::string TileDownloader::getAttribute(const char* tag, const char* tagEnd, const char* name)
 {
-	TiXmlDocument doc;
-	doc.LoadFile(collectionFilePath);
+	size_t length = strlen(name);
+	for (const char* c = tag; c + length + 2 <= tagEnd; ++c)
+	{
+		if (!isspace((unsigned char) c[0]) || strncmp(c+1, name, length) != 0)
+			continue;
+
+		const char* value = c + 1 + length;
+		while (value < tagEnd && isspace((unsigned char) *value))
+			value++;
+		if (value >= tagEnd || *value != '=')
+			continue;
+		value++;
+		while (value < tagEnd && isspace((unsigned char) *value))
+			value++;
+		if (value >= tagEnd || (*value != '"' && *value != '\''))
+			continue;
+
+		char quote = *value++;
+		const char* valueEnd = std::find(value, tagEnd, quote);
+
+		return decodeEntities(value, valueEnd);
+	}
 
-	TiXmlHandle handle(&doc);
-	TiXmlElement* parent = handle.FirstChildElement().FirstChildElement().Element();
-	
-	mPictures.clear();
+	return "";
+}
 
-	for (TiXmlNode* elt = parent->FirstChild("I"); elt; elt = elt->NextSibling("I"))
+std::string TileDownloader::decodeEntities(const char* begin, const char* end)
+{
+	static const char* entities[]  = { "&amp;", "&lt;", "&gt;", "&quot;", "&apos;" };
+	static const char  characters[] = { '&', '<', '>', '"', '\'' };
+
+	std::string result;
+	result.reserve(end - begin);
+	for (const char* c = begin; c < end; ++c)
 	{
-		TiXmlElement* size = elt->FirstChild("Size")->ToElement();
-
-		PictureInfo pictureInfo;		
-		std::string url      = elt->ToElement()->Attribute("Source");
-		pictureInfo.id       = atoi(elt->ToElement()->Attribute("Id"));;
-		pictureInfo.width    = atoi(size->Attribute("Width"));
-		pictureInfo.height   = atoi(size->Attribute("Height"));
-		pictureInfo.nbColumn = (unsigned int) Ogre::Math::Ceil(pictureInfo.width/510.0f);
-		pictureInfo.nbRow    = (unsigned int) Ogre::Math::Ceil(pictureInfo.height/510.0f);
-		pictureInfo.nbLevel  = getPOT(std::max(pictureInfo.width, pictureInfo.height));
-				
-		std::stringstream replacement;
-		replacement << "_files/" << pictureInfo.nbLevel << "/";
-		url = Ogre::StringUtil::replaceAll(url, ".dzi", replacement.str());
-		pictureInfo.url = url;
-
-
-
-		std::stringstream pictureFilePath;
-		pictureFilePath << mProjectPath << "hd/";
-		pictureFilePath.width(8);
-		pictureFilePath.fill('0');
-		pictureFilePath << pictureInfo.id << ".jpg";
-		pictureInfo.filePath = pictureFilePath.str();
-				
-		for (unsigned int i=0; i<pictureInfo.nbColumn; ++i)
+		bool decoded = false;
+		if (*c == '&')
 		{
-			for (unsigned int j=0; j<pictureInfo.nbRow; ++j)
+			for (unsigned int k=0; k<sizeof(characters) && !decoded; ++k)
 			{
-				std::stringstream tileUrl;
-				tileUrl <<  url << i << "_" << j << ".jpg";
-
-				std::stringstream tileFilePath;
-				tileFilePath << mProjectPath << "hd/tmp/" << j << "_" << i << ".jpg";
-
-				TileInfo tileInfo;
-				tileInfo.i = i;
-				tileInfo.j = j;
-				tileInfo.url  = tileUrl.str();
-				tileInfo.filePath = tileFilePath.str();
-				pictureInfo.tiles.push_back(tileInfo);
+				size_t length = strlen(entities[k]);
+				if ((size_t)(end - c) >= length && strncmp(c, entities[k], length) == 0)
+				{
+					result += characters[k];
+					c += length - 1;
+					decoded = true;
+				}
 			}
 		}
-		mPictures.push_back(pictureInfo);
+		if (!decoded)
+			result += *c;
 	}
+
+	return result;
+}
+
+std::string PictureInfo::getTileUrl(unsigned int i, unsigned int j) const
+{
+	std::stringstream tileUrl;
+	tileUrl << url << i << "_" << j << ".jpg";
+
+	return tileUrl.str();
 }
 
 unsigned int TileDownloader::getPOT(int value) 
@@ -0,0 +1,244 @@
+/*
+	Copyright (c) 2010 ASTRE Henri (http://www.visual-experiments.com)
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+	THE SOFTWARE.
+*/
+
+#include "PhotoSynthTileTelemetry.h"
+
+#include <iomanip>
+#include <algorithm>
+
+using namespace PhotoSynth;
+
+const unsigned int Histogram::nbBucket;
+
+Histogram::Histogram()
+{
+	std::fill(mBuckets, mBuckets + nbBucket, 0);
+	mCount = 0;
+	mSum   = 0;
+	mMax   = 0;
+}
+
+void Histogram::add(double value)
+{
+	unsigned int bucket = 0;
+	double upperBound = 1.0;
+	while (value >= upperBound && bucket < nbBucket-1)
+	{
+		bucket++;
+		upperBound *= 2.0;
+	}
+
+	mBuckets[bucket]++;
+	mCount++;
+	mSum += value;
+	mMax  = std::max(mMax, value);
+}
+
+unsigned int Histogram::getCount() const
+{
+	return mCount;
+}
+
+double Histogram::getMean() const
+{
+	return mCount > 0 ? mSum / mCount : 0;
+}
+
+double Histogram::getMax() const
+{
+	return mMax;
+}
+
+double Histogram::getPercentile(double percent) const
+{
+	if (mCount == 0)
+		return 0;
+
+	unsigned int rank = (unsigned int) (percent / 100.0 * mCount);
+	unsigned int count = 0;
+	double upperBound = 1.0;
+	for (unsigned int i=0; i<nbBucket; ++i, upperBound *= 2.0)
+	{
+		count += mBuckets[i];
+		if (count > rank)
+			return std::min(upperBound, mMax);
+	}
+
+	return mMax;
+}
+
+void Histogram::writeJson(std::ostream& output) const
+{
+	output << "{\"count\":" << mCount << ",\"mean\":" << getMean();
+	output << ",\"p50\":" << getPercentile(50) << ",\"p90\":" << getPercentile(90) << ",\"p99\":" << getPercentile(99);
+	output << ",\"max\":" << mMax << ",\"buckets\":[";
+	for (unsigned int i=0; i<nbBucket; ++i)
+		output << (i > 0 ? "," : "") << mBuckets[i];
+	output << "]}";
+}
+
+TileTelemetry::TileTelemetry()
+{
+	start(0);
+}
+
+void TileTelemetry::start(unsigned int nbPicture)
+{
+	boost::mutex::scoped_lock lock(mMutex);
+
+	mStartTime          = boost::posix_time::microsec_clock::universal_time();
+	mLastSnapshotTime   = mStartTime;
+	mNbPicture          = nbPicture;
+	mNbPictureDone      = 0;
+	mNbTile             = 0;
+	mNbTileFailure      = 0;
+	mLastSnapshotNbTile = 0;
+	mNbByte             = 0;
+	mLastSnapshotNbByte = 0;
+	mTileLatency        = Histogram();
+	mPictureDownload    = Histogram();
+	mPictureCompose     = Histogram();
+	mQueueDepth         = 0;
+	mQueueCapacity      = 0;
+	mMaxQueueDepth      = 0;
+	mQueueDepthSum      = 0;
+	mNbQueueSample      = 0;
+	mConnectionStats    = ConnectionStats();
+}
+
+void TileTelemetry::addTile(std::size_t size, double latency)
+{
+	boost::mutex::scoped_lock lock(mMutex);
+	mNbTile++;
+	mNbByte += size;
+	mTileLatency.add(latency);
+}
+
+void TileTelemetry::addTileFailure()
+{
+	boost::mutex::scoped_lock lock(mMutex);
+	mNbTileFailure++;
+}
+
+void TileTelemetry::addPictureDownload(double duration)
+{
+	boost::mutex::scoped_lock lock(mMutex);
+	mPictureDownload.add(duration);
+}
+
+void TileTelemetry::addPictureCompose(double duration)
+{
+	boost::mutex::scoped_lock lock(mMutex);
+	mPictureCompose.add(duration);
+}
+
+void TileTelemetry::addPictureDone()
+{
+	boost::mutex::scoped_lock lock(mMutex);
+	mNbPictureDone++;
+}
+
+void TileTelemetry::sampleQueue(unsigned int depth, unsigned int capacity)
+{
+	boost::mutex::scoped_lock lock(mMutex);
+	mQueueDepth     = depth;
+	mQueueCapacity  = capacity;
+	mMaxQueueDepth  = std::max(mMaxQueueDepth, depth);
+	mQueueDepthSum += depth;
+	mNbQueueSample++;
+}
+
+void TileTelemetry::setConnectionStats(const ConnectionStats& stats)
+{
+	boost::mutex::scoped_lock lock(mMutex);
+	mConnectionStats = stats;
+}
+
+void TileTelemetry::writeJson(std::ostream& output, const std::string& event)
+{
+	boost::mutex::scoped_lock lock(mMutex);
+
+	boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+	double elapsed  = (now - mStartTime).total_milliseconds() / 1000.0;
+	double interval = (now - mLastSnapshotTime).total_milliseconds() / 1000.0;
+
+	//rates over the whole run for the summary, since the previous snapshot for progress lines
+	double rateDuration = (event == "summary") ? elapsed : interval;
+	unsigned int nbTile   = (event == "summary") ? mNbTile : mNbTile - mLastSnapshotNbTile;
+	boost::uint64_t nbByte = (event == "summary") ? mNbByte : mNbByte - mLastSnapshotNbByte;
+	double tileRate = rateDuration > 0 ? nbTile / rateDuration : 0;
+	double byteRate = rateDuration > 0 ? nbByte / rateDuration : 0;
+
+	std::ios::fmtflags flags = output.flags();
+	std::streamsize precision = output.precision();
+	output << std::fixed << std::setprecision(1);
+
+	output << "{\"event\":\"" << event << "\",\"elapsed\":" << elapsed;
+	output << ",\"pictures\":{\"done\":" << mNbPictureDone << ",\"total\":" << mNbPicture << "}";
+	output << ",\"tiles\":{\"count\":" << mNbTile << ",\"failures\":" << mNbTileFailure << ",\"bytes\":" << mNbByte;
+	output << ",\"tilesPerSecond\":" << tileRate << ",\"bytesPerSecond\":" << byteRate << "}";
+	output << ",\"tileLatency\":";
+	mTileLatency.writeJson(output);
+	output << ",\"pictureDownload\":";
+	mPictureDownload.writeJson(output);
+	output << ",\"pictureCompose\":";
+	mPictureCompose.writeJson(output);
+	output << ",\"queue\":{\"depth\":" << mQueueDepth << ",\"capacity\":" << mQueueCapacity << ",\"max\":" << mMaxQueueDepth;
+	output << ",\"mean\":" << (mNbQueueSample > 0 ? mQueueDepthSum / mNbQueueSample : 0) << "}";
+	output << ",\"connections\":{\"new\":" << mConnectionStats.nbConnection << ",\"reused\":" << mConnectionStats.nbReuse;
+	output << ",\"resolveMs\":" << (mConnectionStats.nbConnection > 0 ? mConnectionStats.resolveTime / mConnectionStats.nbConnection : 0);
+	output << ",\"connectMs\":" << (mConnectionStats.nbConnection > 0 ? mConnectionStats.connectTime / mConnectionStats.nbConnection : 0) << "}";
+	output << "}" << std::endl;
+
+	output.flags(flags);
+	output.precision(precision);
+
+	mLastSnapshotTime   = now;
+	mLastSnapshotNbTile = mNbTile;
+	mLastSnapshotNbByte = mNbByte;
+}
+
+void TileTelemetry::print(std::ostream& output) const
+{
+	boost::mutex::scoped_lock lock(mMutex);
+
+	double elapsed = (boost::posix_time::microsec_clock::universal_time() - mStartTime).total_milliseconds() / 1000.0;
+
+	std::ios::fmtflags flags = output.flags();
+	std::streamsize precision = output.precision();
+	output << std::fixed << std::setprecision(1);
+
+	output << "Network: " << mNbTile << " tiles (" << mNbTileFailure << " failures), " << mNbByte/(1024*1024) << " MB in " << elapsed << " s";
+	if (elapsed > 0)
+		output << " (" << mNbTile/elapsed << " tiles/s, " << mNbByte/(1024.0*elapsed) << " KB/s)";
+	output << std::endl;
+	output << "Tile latency: mean " << mTileLatency.getMean() << " ms, p50 " << mTileLatency.getPercentile(50) << " ms, p99 " << mTileLatency.getPercentile(99) << " ms, max " << mTileLatency.getMax() << " ms" << std::endl;
+	output << "Connections: " << mConnectionStats.nbConnection << " opened, " << mConnectionStats.nbReuse << " reused";
+	if (mConnectionStats.nbConnection > 0)
+		output << ", resolve " << mConnectionStats.resolveTime / mConnectionStats.nbConnection << " ms, connect " << mConnectionStats.connectTime / mConnectionStats.nbConnection << " ms";
+	output << std::endl;
+	output << "Compose: " << mPictureCompose.getCount() << " pictures, mean " << mPictureCompose.getMean() << " ms, p99 " << mPictureCompose.getPercentile(99) << " ms" << std::endl;
+	output << "Compose queue: mean depth " << (mNbQueueSample > 0 ? mQueueDepthSum / mNbQueueSample : 0) << ", max " << mMaxQueueDepth << " / " << mQueueCapacity << std::endl;
+
+	output.flags(flags);
+	output.precision(precision);
+}
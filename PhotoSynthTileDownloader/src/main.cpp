@@ -21,28 +21,65 @@
 */
 
 #include "PhotoSynthTileDownloader.h"
+#include <memory>
+#include <cstdlib>
+#include <algorithm>
+#include <boost/thread/thread.hpp>
 
 int main(int argc, char* argv[])
 {
-	if (argc != 2)
+	if (argc < 2)
 	{
-		std::cout << "Usage: " << argv[0] << " <inputPath>"<<std::endl;
+		std::cout << "Usage: " << argv[0] << " <inputPath> [optional]"<<std::endl;
+		std::cout << "[optional] : timeout=<ms> attempts=<n> backoff=<ms> (network retry policy)" <<std::endl;
+		std::cout << "[optional] : cache=<folder> cachesize=<MB> (local cache of downloaded files shared by all projects)" <<std::endl;
+		std::cout << "[optional] : download=<n> compose=<n> (pictures downloaded / composed simultaneously)" <<std::endl;
+		std::cout << "[optional] : lossless (copy jpeg coefficients instead of re-encoding when tiles are aligned)" <<std::endl;
+		std::cout << "[optional] : coordsystem=<n> top=<k> pictures=<i,j,k-l> (only download these pictures, most observed first)" <<std::endl;
+		std::cout << "[optional] : levels=<n> (also write 1/2, 1/4, 1/8 scale pictures in hd/level1, hd/level2, hd/level3)" <<std::endl;
+		std::cout << "[optional] : telemetry=<s> (seconds between two progress lines of hd/telemetry.jsonl, 0: summary only)" <<std::endl;
 		std::cout << "Example: "<<argv[0]<< " c:\\mySynth\\"<<std::endl;
-		std::cout << "If you have downloaded thumbs it will copy Exif Data from thumbs to HD using JHead" << std::endl;
+		std::cout << "If you have downloaded thumbs it will copy Exif Data from thumbs to HD" << std::endl;
 
 		return -1;
 	}	
 	
 	std::string projectFolder = argv[1];
 
-	boost::asio::io_service* service;
+	PhotoSynth::DownloadPolicy policy;
+	std::string cacheFolder;
+	boost::uintmax_t cacheSize = PhotoSynth::DownloadCache::defaultMaxSize;
+	unsigned int nbDownloadThread = 16;
+	unsigned int nbComposeThread  = std::max(boost::thread::hardware_concurrency(), 1u);
+	bool lossless = false;
+	unsigned int nbLowerLevel = 0;
+	unsigned int telemetryInterval = 5;
+	PhotoSynth::PictureFilter filter;
 	try
 	{
-		service = new boost::asio::io_service;
-		service->run();
+		for (int i=2; i<argc; ++i)
+		{
+			std::string current(argv[i]);
+			if (current == "lossless")
+				lossless = true;
+			else if (current.find("levels=") == 0)
+				nbLowerLevel = (unsigned int) atoi(current.substr(7).c_str());
+			else if (current.find("telemetry=") == 0)
+				telemetryInterval = (unsigned int) atoi(current.substr(10).c_str());
+			else if (current.find("download=") == 0)
+				nbDownloadThread = (unsigned int) atoi(current.substr(9).c_str());
+			else if (current.find("compose=") == 0)
+				nbComposeThread = (unsigned int) atoi(current.substr(8).c_str());
+			else if (!PhotoSynth::DownloadCache::parseArgument(current, cacheFolder, cacheSize) && !filter.parseArgument(current))
+				policy.parseArgument(current);
+		}
 
-		PhotoSynth::TileDownloader downloader(service);
-		downloader.download(projectFolder);
+		std::auto_ptr<PhotoSynth::DownloadCache> cache;
+		if (!cacheFolder.empty())
+			cache.reset(new PhotoSynth::DownloadCache(cacheFolder, cacheSize));
+
+		PhotoSynth::TileDownloader downloader(policy, cache.get(), nbDownloadThread, nbComposeThread, lossless, nbLowerLevel, telemetryInterval);
+		downloader.download(projectFolder, filter);
 	}
 	catch(std::exception& e)
 	{
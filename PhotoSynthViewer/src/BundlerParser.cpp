@@ -21,6 +21,7 @@
 */
 
 #include "BundlerParser.h"
+#include <PhotoSynthPlyReader.h>
 
 #include <OgreVector2.h>
 #include <OgreString.h>
@@ -195,149 +196,57 @@ const std::vector<Vertex>& Parser::getVertices() const
 const Mesh&	Bundler::importPly(const std::string& filepath)
 {
 	static Mesh mesh;
+	mesh = Mesh();
 
-	Ogre::Vector3 noNormalValue(Ogre::Vector3::ZERO);
-	Ogre::ColourValue noColorValue(0.f, 0.f, 0.f, 0.f);
-
-	std::ifstream input;
-	input.open(filepath.c_str(), std::ios::binary);
-
-	if (!input.is_open())
+	PhotoSynth::PlyReader reader;
+	if (!reader.open(filepath))
 		return mesh;
 
-	std::string line;
-	unsigned int nbVertices = 0;
-	unsigned int nbTriangles = 0;
-	bool isBinaryFile = false;
-	bool hasNormals = false;
-	bool hasColors  = false;
-	bool hasAlpha   = false;
-
-	//parse header
-	do 
+	const PhotoSynth::PlyReader::Element* vertexElement = reader.getElement("vertex");
+	if (vertexElement && vertexElement->count > 0)
 	{
-		std::getline(input, line);
-
-		//property list uchar int vertex_indices
-
-		if (line == "format binary_little_endian 1.0")
-			isBinaryFile = true;
-		else if (line == "format ascii 1.0")
-			isBinaryFile = false;
-		else if (line == "property float nx")
-			hasNormals = true;
-		else if (line == "property uchar red")
-			hasColors = true;
-		else if (line == "property uchar alpha")
-			hasAlpha = true;
-		else if (line == "property uchar diffuse_red")
-			hasColors = true;
-		else if (line == "property uchar diffuse_alpha")
-			hasAlpha = true;
-		else
+		bool hasColors        = vertexElement->getProperty("red") != NULL;
+		bool hasDiffuseColors = vertexElement->getProperty("diffuse_red") != NULL;
+		Ogre::ColourValue defaultColor = (hasColors || hasDiffuseColors) ? Ogre::ColourValue::White : Ogre::ColourValue(0.f, 0.f, 0.f, 0.f);
+
+		mesh.vertices.resize(vertexElement->count, Vertex(Ogre::Vector3::ZERO, defaultColor, Ogre::Vector3::ZERO));
+
+		Vertex& first = mesh.vertices[0];
+		std::size_t stride = sizeof(Vertex);
+		std::vector<PhotoSynth::PlyReader::Field> fields;
+		fields.push_back(PhotoSynth::PlyReader::Field("x",  &first.position.x, stride));
+		fields.push_back(PhotoSynth::PlyReader::Field("y",  &first.position.y, stride));
+		fields.push_back(PhotoSynth::PlyReader::Field("z",  &first.position.z, stride));
+		fields.push_back(PhotoSynth::PlyReader::Field("nx", &first.normal.x,   stride));
+		fields.push_back(PhotoSynth::PlyReader::Field("ny", &first.normal.y,   stride));
+		fields.push_back(PhotoSynth::PlyReader::Field("nz", &first.normal.z,   stride));
+		std::string colorPrefix = hasColors ? "" : "diffuse_";
+		if (hasColors || hasDiffuseColors)
 		{
-			std::string keywordVertex("element vertex ");
-			unsigned int lengthVertex = keywordVertex.size();
-
-			std::string keywordFace("element face ");
-			unsigned int lengthFace = keywordFace.size();
-
-			if (line.size() > lengthVertex && line.substr(0, lengthVertex) == keywordVertex)
-			{
-				//std::string tmpVertex = line.substr(lengthVertex);
-				nbVertices = atoi(line.substr(lengthVertex).c_str());
-			}
-			else if (line.size() > lengthFace && line.substr(0, lengthFace) == keywordFace)
-			{
-				//std::string tmpFace = line.substr(lengthFace);
-				nbTriangles = atoi(line.substr(lengthFace).c_str());
-			}
+			fields.push_back(PhotoSynth::PlyReader::Field(colorPrefix + "red",   &first.color.r, stride, 1.0f/255.0f));
+			fields.push_back(PhotoSynth::PlyReader::Field(colorPrefix + "green", &first.color.g, stride, 1.0f/255.0f));
+			fields.push_back(PhotoSynth::PlyReader::Field(colorPrefix + "blue",  &first.color.b, stride, 1.0f/255.0f));
 		}
-	} while (line != "end_header"); //missing eof check...
-
-	mesh.vertices.reserve(nbVertices);
-	mesh.triangles.reserve(nbTriangles);
-
-	if (!isBinaryFile)
-	{
-		float* pos = new float[hasNormals?6:3];
-		int* color = new int[hasAlpha?4:3];
 
-		for (unsigned int i=0; i<nbVertices; ++i)
-		{
-			input >> pos[0]; //x
-			input >> pos[1]; //y
-			input >> pos[2]; //z
-			if (hasNormals)
-			{
-				input >> pos[3]; //nx
-				input >> pos[4]; //ny
-				input >> pos[5]; //nz
-			}
-			if (hasColors)
-			{
-				input >> color[0]; //r
-				input >> color[1]; //g
-				input >> color[2]; //b
-				if (hasAlpha)
-					input >> color[3]; //a
-			}
-
-			Ogre::Vector3 position((Ogre::Real)pos[0], (Ogre::Real)pos[1], (Ogre::Real)pos[2]);
-			Ogre::ColourValue colorValue = hasColors ? Ogre::ColourValue(color[0]/255.0f, color[1]/255.0f, color[2]/255.0f) : noColorValue;
-			Ogre::Vector3 normal = hasNormals ? Ogre::Vector3((Ogre::Real)pos[3], (Ogre::Real)pos[4], (Ogre::Real)pos[5]) : noNormalValue;
-
-			mesh.vertices.push_back(Vertex(position, colorValue, normal));
-		}
-
-		unsigned char three;
-		int indexA;
-		int indexB;
-		int indexC;
-		for (unsigned int i=0; i<nbTriangles; ++i)
-		{
-			input >> three; //I know a triangle face is composed of 3 vertex ;-)
-			input >>indexA;
-			input >>indexB;
-			input >>indexC;
-			mesh.triangles.push_back(Triangle(indexA, indexB, indexC));
-		}
-		delete[] pos;
-		delete[] color;
+		if (!reader.read("vertex", fields))
+			mesh.vertices.clear();
 	}
-	else
-	{
-		float* pos = new float[hasNormals?6:3];
-		size_t sizePos = sizeof(float)*(hasNormals?6:3);
 
-		unsigned char* color = new unsigned char[hasAlpha?4:3];
-		size_t sizeColor = sizeof(unsigned char)*(hasAlpha?4:3);
-
-		for (unsigned int i=0; i<nbVertices; ++i)
-		{
-			input.read((char*)pos, sizePos);
-			if (hasColors)
-				input.read((char*)color, sizeColor);
-
-			Ogre::Vector3 position((Ogre::Real)pos[0], (Ogre::Real)pos[1], (Ogre::Real)pos[2]);
-			Ogre::ColourValue colorValue = hasColors ? Ogre::ColourValue(color[0]/255.0f, color[1]/255.0f, color[2]/255.0f) : noColorValue;
-			Ogre::Vector3 normal = hasNormals ? Ogre::Vector3((Ogre::Real)pos[3], (Ogre::Real)pos[4], (Ogre::Real)pos[5]) : noNormalValue;
-			mesh.vertices.push_back(Vertex(position, colorValue, normal));
-		}
-
-		unsigned char three = 3;
-		int indexes[3];
-		for (unsigned int i=0; i<nbTriangles; ++i)
+	//faces are triangulated as fans (PMVS and MeshLab write triangles)
+	const PhotoSynth::PlyReader::Element* faceElement = reader.getElement("face");
+	std::vector<unsigned int> counts;
+	std::vector<int> indexes;
+	if (faceElement && reader.readList("face", faceElement->getProperty("vertex_index") ? "vertex_index" : "vertex_indices", counts, indexes))
+	{
+		mesh.triangles.reserve(indexes.size() / 3);
+		unsigned int offset = 0;
+		for (unsigned int i=0; i<counts.size(); ++i)
 		{
-			input.read((char*)&three, sizeof(three));
-			input.read((char*)indexes, sizeof(indexes));
-			mesh.triangles.push_back(Triangle(indexes[0], indexes[1], indexes[2]));
+			for (unsigned int j=2; j<counts[i]; ++j)
+				mesh.triangles.push_back(Triangle(indexes[offset], indexes[offset+j-1], indexes[offset+j]));
+			offset += counts[i];
 		}
-		delete[] pos;
-		delete[] color;
 	}
 
-	input.close();
-
 	return mesh;
 }
\ No newline at end of file